@@ -8,13 +8,19 @@
 #include <cstring>
 #include <climits>
 #include <cstdint>
+#include <utility>
 #include "umba/stl.h"
 
 #include "umba/i_char_writer.h"
 #include "umba/assert.h"
 
+#include "umba/simple_formatter_simd.h"
+#include "umba/simple_formatter_unicode.h"
+
 #if !defined(UMBA_MCU_USED)
     #include <string>
+    #include <vector>
+    #include "umba/simple_formatter_bigint.h"
 #endif
 
 #define UMBA_SIMPLE_FORMATTER_H
@@ -31,6 +37,16 @@
 #endif
 
 
+#if defined(__SIZEOF_INT128__) && !defined(UMBA_MCU_USED) && !defined(UMBA_SIMPLE_FORMATTER_NO_INT128)
+    #define UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED
+#endif
+
+#if !defined(UMBA_MCU_USED) && ( __cplusplus>=201703L || (defined(_MSVC_LANG) && _MSVC_LANG>=201703L) )
+    #define UMBA_SIMPLE_FORMATTER_STRING_VIEW_SUPPORTED
+    #include <string_view>
+#endif
+
+
 namespace umba
 {
 
@@ -41,68 +57,183 @@ namespace format_utils
 {
 
 
-static const size_t integral_max_bits = ( (sizeof(uintptr_t) >= sizeof(uintmax_t)) ? (sizeof(uintptr_t)*CHAR_BIT) : (sizeof(uintmax_t)*CHAR_BIT));
+#if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+
+    __extension__ typedef unsigned __int128  uint128_t;
+    __extension__ typedef __int128           int128_t;
+
+    static const size_t integral_max_bits = sizeof(uint128_t)*CHAR_BIT;
+
+#else
+
+    static const size_t integral_max_bits = ( (sizeof(uintptr_t) >= sizeof(uintmax_t)) ? (sizeof(uintptr_t)*CHAR_BIT) : (sizeof(uintmax_t)*CHAR_BIT));
+
+#endif
 
 //-----------------------------------------------------------------------------
-template<typename IntType, typename BaseType>
-size_t formatIntImpl( IntType val, BaseType base, const char *digits, char *pBuf, int width, char fillCh
-                    , int groupSize, char groupSep
-                    , int &grpSepCounter, int &digitsCounter
-                    , std::false_type signedIntType
-                    )
+//! std::make_unsigned, расширенный для 128ми-битных типов (в строгом режиме стандарта std::make_unsigned их не поддерживает)
+template<typename T>
+struct make_unsigned_ext
 {
-    UMBA_USED(signedIntType);
+    typedef typename std::make_unsigned<T>::type type;
+};
 
-    if (groupSize<1)
-        groupSize = 0;
+#if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
 
-    grpSepCounter = 0;
-    digitsCounter = 0;
+template<>
+struct make_unsigned_ext<int128_t>
+{
+    typedef uint128_t type;
+};
+
+template<>
+struct make_unsigned_ext<uint128_t>
+{
+    typedef uint128_t type;
+};
+
+#endif
+
+//-----------------------------------------------------------------------------
+//! Вывод цифр, разбитых на группы разрядов.
+/*! Цифры в pDigits идут от старших к младшим, перед ними выводится numZeros нулей.
+    Количество разделителей и длина первой (старшей) группы вычисляются заранее,
+    далее группы копируются целиком, без проверки номера разряда на каждой цифре.
+    Возвращает количество символов, записанных в pBuf.
+ */
+inline
+size_t formatDigitGroups( const char *pDigits, int numDigits, int numZeros, char *pBuf
+                        , int groupSize, char groupSep, int &grpSepCounter
+                        )
+{
+    int totalDigits = numDigits + numZeros;
+
+    int numSeps = 0;
+    if (groupSize>0 && totalDigits>groupSize)
+        numSeps = (totalDigits-1) / groupSize;
+
+    grpSepCounter = numSeps;
 
     char *pBufEnd = pBuf;
-    while(val)
+    int   grpLen  = numSeps ? totalDigits - numSeps*groupSize : totalDigits;
+
+    for(;;)
     {
-        if (groupSize && digitsCounter && (digitsCounter % groupSize)==0 && val)
+        int zerosLen = numZeros<grpLen ? numZeros : grpLen;
+        if (zerosLen>0)
         {
-            *pBufEnd++ = groupSep;
-            grpSepCounter++;
+            std::memset(pBufEnd, '0', (size_t)zerosLen);
+            pBufEnd  += zerosLen;
+            numZeros -= zerosLen;
+        }
+        else
+        {
+            zerosLen = 0;
         }
-        
-        IntType d = (IntType)(val % (IntType)base);
-        *pBufEnd++ = digits[(unsigned)d];
-        val /= (IntType)base;
-        //*pBufEnd = 0; // tmp for debug
 
-        digitsCounter++;
-    }
+        int digitsLen = grpLen - zerosLen;
+        std::memcpy(pBufEnd, pDigits, (size_t)digitsLen);
+        pBufEnd += digitsLen;
+        pDigits += digitsLen;
 
-    if (pBufEnd == pBuf)
-    {
-       *pBufEnd++ = '0';
-       digitsCounter++;
+        if (!numSeps)
+            break;
+
+        *pBufEnd++ = groupSep;
+        grpLen     = groupSize;
+        --numSeps;
     }
 
+    return (size_t)(pBufEnd - pBuf);
+}
+
+//-----------------------------------------------------------------------------
+//! Количество цифр, включая ведущие нули, при котором число с разделителями групп займет не менее width символов
+inline
+int calcZeroFilledDigits( int numDigits, int width, int groupSize )
+{
+    if (groupSize<1)
+        return numDigits<width ? width : numDigits;
+
+    // n цифр с разделителями занимают n + (n-1)/groupSize символов
+    // ищем минимальное m = n-1, для которого m + m/groupSize >= width-1
+    int target = width - 1;
+    if (numDigits-1 + (numDigits-1)/groupSize >= target)
+        return numDigits;
+
+    int m = (int)(((long long)target * groupSize) / (groupSize+1));
+    while(m + m/groupSize < target)
+        ++m;
+    while(m>0 && (m-1) + (m-1)/groupSize >= target)
+        --m;
+
+    return m + 1;
+}
+
+//-----------------------------------------------------------------------------
+//! Вывод готовых цифр беззнакового числа с заполнением до ширины width и разбиением на группы разрядов
+inline
+size_t formatUnsignedDigits( const char *pDigits, int numDigits, char *pBuf, int width, char fillCh
+                           , int groupSize, char groupSep
+                           , int &grpSepCounter, int &digitsCounter
+                           )
+{
+    if (groupSize<1)
+        groupSize = 0;
+
     if (width<0)
         width = 0;
 
-    while((int)(pBufEnd - pBuf) < width)
+    if (fillCh!='0')
     {
-        if (fillCh=='0')
+        int numSeps = groupSize && numDigits>groupSize ? (numDigits-1)/groupSize : 0;
+        int fillLen = width - (numDigits + numSeps);
+        if (fillLen>0)
         {
-            if (groupSize && digitsCounter && (digitsCounter % groupSize)==0 )
-            {
-                *pBufEnd++ = groupSep;
-                grpSepCounter++;
-            }
-            digitsCounter++;
+            std::memset(pBuf, fillCh, (size_t)fillLen);
+            pBuf += fillLen;
         }
-        *pBufEnd++ = fillCh;
-        //*pBufEnd = 0; // tmp for debug
+        else
+        {
+            fillLen = 0;
+        }
+
+        digitsCounter = numDigits;
+        return (size_t)fillLen + formatDigitGroups(pDigits, numDigits, 0, pBuf, groupSize, groupSep, grpSepCounter);
     }
 
-    std::reverse(pBuf, pBufEnd);
+    // Заполнение нулями - нули являются частью числа и разбиваются на группы вместе с ним
+    int numZeros  = calcZeroFilledDigits(numDigits, width, groupSize) - numDigits;
 
-    return (size_t)(pBufEnd - pBuf);
+    digitsCounter = numDigits + numZeros;
+    return formatDigitGroups(pDigits, numDigits, numZeros, pBuf, groupSize, groupSep, grpSepCounter);
+}
+
+//-----------------------------------------------------------------------------
+template<typename IntType, typename BaseType>
+size_t formatIntImpl( IntType val, BaseType base, const char *digits, char *pBuf, int width, char fillCh
+                    , int groupSize, char groupSep
+                    , int &grpSepCounter, int &digitsCounter
+                    , std::false_type signedIntType
+                    )
+{
+    UMBA_USED(signedIntType);
+
+    // Цифры формируем с конца буфера, чтобы они сразу шли от старших к младшим
+    char  digitsBuf[integral_max_bits];
+    char *pDigitsEnd = &digitsBuf[0] + sizeof(digitsBuf);
+    char *pDigits    = pDigitsEnd;
+
+    do
+    {
+        IntType d = (IntType)(val % (IntType)base);
+        *--pDigits = digits[(unsigned)d];
+        val /= (IntType)base;
+    } while(val);
+
+    return formatUnsignedDigits( pDigits, (int)(pDigitsEnd - pDigits), pBuf, width, fillCh
+                               , groupSize, groupSep, grpSepCounter, digitsCounter
+                               );
 }
 
 // buf must points to an array at least 128 chars length
@@ -119,50 +250,174 @@ size_t formatIntImpl( IntType val, BaseType base, const char *digits, char *pBuf
     if (groupSize<1)
         groupSize = 0;
 
-    grpSepCounter = 0;
-    digitsCounter = 0;
+    char  digitsBuf[integral_max_bits];
+    char *pDigitsEnd = &digitsBuf[0] + sizeof(digitsBuf);
+    char *pDigits    = pDigitsEnd;
 
-    char *pBufEnd = pBuf;
-    while(val)
+    do
     {
-        if (groupSize && digitsCounter && (digitsCounter % groupSize)==0 && val)
-        {
-            *pBufEnd++ = groupSep;
-            grpSepCounter++;
-        }
-
         IntType d = val % (IntType)base;
-        *pBufEnd++ = d<0 ? digits[-d] : digits[d];
+        *--pDigits = d<0 ? digits[-d] : digits[d];
         val /= (IntType)base;
+    } while(val);
+
+    digitsCounter = (int)(pDigitsEnd - pDigits);
+
+    return formatDigitGroups(pDigits, digitsCounter, 0, pBuf, groupSize, groupSep, grpSepCounter);
+}
+
+inline
+const char* getDigitChars( bool uppercase )
+{
+    static const char upperDigits[] = "0123456789ABCDEF";
+    static const char lowerDigits[] = "0123456789abcdef";
+    return uppercase ? upperDigits : lowerDigits;
+}
+
+template<typename IntType, typename BaseType>
+size_t formatIntImpl(IntType val, BaseType base, bool uppercase, char *pBuf, int width, char fillCh, int groupSize, char groupSep, int &grpSepCounter, int &digitsCounter )
+{
+    if (base<2)
+        base = 2;
+
+    if (base>16)
+        base = 16;
+
+    return formatIntImpl(val, base, getDigitChars(uppercase), pBuf, width, fillCh, groupSize, groupSep, grpSepCounter, digitsCounter, std::is_signed<IntType>());
+}
+
+//-----------------------------------------------------------------------------
+//! Длина ASCII-Z строки, но не более maxLen (аналог strnlen). Байты за пределами maxLen не читаются
+inline
+size_t boundedStrLen( const char *str, size_t maxLen )
+{
+    const char *pZero = (const char*)std::memchr(str, 0, maxLen);
+    return pZero ? (size_t)(pZero - str) : maxLen;
+}
 
-        digitsCounter++;
+//-----------------------------------------------------------------------------
+//! Длина префикса строки не более len байт, не разрывающая многобайтный символ UTF-8
+/*! str[len] должен быть доступен - по нему определяется, начинается ли с len новый символ
+ */
+inline
+size_t utf8TruncateLen( const char *str, size_t len )
+{
+    size_t res = len;
+    // Продолжения (10xxxxxx) не бывает больше трех подряд - если больше, это не UTF-8, режем как есть
+    while(res && (len-res)<3 && (((unsigned char)str[res]) & 0xC0)==0x80)
+        --res;
+    return (((unsigned char)str[res]) & 0xC0)==0x80 ? len : res;
+}
+
+#if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+
+//-----------------------------------------------------------------------------
+//! Формирует цифры 128ми-битного числа с конца буфера, возвращает указатель на старшую цифру
+/*! Десятичное преобразование выполняется порциями по 19 цифр (10^19 - максимальная степень 10,
+    помещающаяся в uint64_t): одно 128ми-битное деление на порцию, цифры порции - 64х-битной арифметикой.
+    Для оснований 2, 8, 16 деление не требуется вовсе
+ */
+inline
+char* formatUInt128Digits( uint128_t val, int base, const char *digits, char *pDigitsEnd )
+{
+    char *pDigits = pDigitsEnd;
+
+    if (base==10)
+    {
+        const uint64_t chunkDivisor = 10000000000000000000ull;
+
+        while(val > (uint128_t)UINT64_MAX)
+        {
+            uint128_t q     = val / chunkDivisor;
+            uint64_t  chunk = (uint64_t)(val - q*chunkDivisor);
+            val = q;
+
+            for(int i=0; i!=19; ++i)
+            {
+                *--pDigits = digits[chunk%10u];
+                chunk /= 10u;
+            }
+        }
+
+        uint64_t low = (uint64_t)val;
+        do
+        {
+            *--pDigits = digits[low%10u];
+            low /= 10u;
+        } while(low);
     }
+    else if (base==2 || base==8 || base==16)
+    {
+        unsigned shift = base==2 ? 1u : (base==8 ? 3u : 4u);
+        unsigned mask  = (unsigned)base - 1u;
 
-    if (pBufEnd == pBuf)
+        do
+        {
+            *--pDigits = digits[(unsigned)val & mask];
+            val >>= shift;
+        } while(val);
+    }
+    else
     {
-       *pBufEnd++ = '0';
-       digitsCounter++;
+        do
+        {
+            *--pDigits = digits[(unsigned)(val % (unsigned)base)];
+            val /= (unsigned)base;
+        } while(val);
     }
 
-    std::reverse(pBuf, pBufEnd);
+    return pDigits;
+}
 
-    return (size_t)(pBufEnd - pBuf);
+//-----------------------------------------------------------------------------
+inline
+size_t formatIntImpl(uint128_t val, int base, bool uppercase, char *pBuf, int width, char fillCh, int groupSize, char groupSep, int &grpSepCounter, int &digitsCounter )
+{
+    if (base<2)
+        base = 2;
+
+    if (base>16)
+        base = 16;
+
+    char  digitsBuf[integral_max_bits];
+    char *pDigitsEnd = &digitsBuf[0] + sizeof(digitsBuf);
+    char *pDigits    = formatUInt128Digits(val, base, getDigitChars(uppercase), pDigitsEnd);
+
+    return formatUnsignedDigits( pDigits, (int)(pDigitsEnd - pDigits), pBuf, width, fillCh
+                               , groupSize, groupSep, grpSepCounter, digitsCounter
+                               );
 }
 
-template<typename IntType, typename BaseType>
-size_t formatIntImpl(IntType val, BaseType base, bool uppercase, char *pBuf, int width, char fillCh, int groupSize, char groupSep, int &grpSepCounter, int &digitsCounter )
+//-----------------------------------------------------------------------------
+//! Как и для остальных знаковых типов, выводятся только цифры модуля числа, знак выводит вызывающий
+inline
+size_t formatIntImpl(int128_t val, int base, bool uppercase, char *pBuf, int width, char fillCh, int groupSize, char groupSep, int &grpSepCounter, int &digitsCounter )
 {
+    UMBA_USED(width);
+    UMBA_USED(fillCh);
+
     if (base<2)
         base = 2;
 
     if (base>16)
         base = 16;
 
-    static const char upperDigits[] = "0123456789ABCDEF";
-    static const char lowerDigits[] = "0123456789abcdef";
-    return formatIntImpl(val, base, uppercase ? upperDigits : lowerDigits, pBuf, width, fillCh, groupSize, groupSep, grpSepCounter, digitsCounter, std::is_signed<IntType>());
+    if (groupSize<1)
+        groupSize = 0;
+
+    uint128_t absVal = val<0 ? (uint128_t)0 - (uint128_t)val : (uint128_t)val;
+
+    char  digitsBuf[integral_max_bits];
+    char *pDigitsEnd = &digitsBuf[0] + sizeof(digitsBuf);
+    char *pDigits    = formatUInt128Digits(absVal, base, getDigitChars(uppercase), pDigitsEnd);
+
+    digitsCounter = (int)(pDigitsEnd - pDigits);
+
+    return formatDigitGroups(pDigits, digitsCounter, 0, pBuf, groupSize, groupSep, grpSepCounter);
 }
 
+#endif // UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED
+
 
 } // namespace format_utils
 
@@ -200,6 +455,56 @@ protected:
 
 }; // class SimpleBoolStack
 
+//-----------------------------------------------------------------------------
+//! Стек отступов - хранит приращения, чтобы popIndent возвращал предыдущий отступ
+class SimpleIndentStack
+{
+public:
+
+    static const unsigned maxDepth = 16;
+
+    SimpleIndentStack() : m_depth(0), m_overflow(0), m_total(0) {}
+
+    void push( int n )
+    {
+        if (n<0)
+            n = 0;
+        if (m_depth>=maxDepth)
+        {
+            ++m_overflow; // сверх глубины отступ не увеличивается, но pop остается парным
+            return;
+        }
+        m_stack[m_depth++] = n;
+        m_total += n;
+    }
+
+    void pop()
+    {
+        if (m_overflow)
+        {
+            --m_overflow;
+            return;
+        }
+        if (!m_depth)
+            return;
+        m_total -= m_stack[--m_depth];
+    }
+
+    int total() const
+    {
+        return m_total;
+    }
+
+
+protected:
+
+    int         m_stack[maxDepth];
+    unsigned    m_depth;
+    unsigned    m_overflow;
+    int         m_total;
+
+}; // class SimpleIndentStack
+
 } // namespace formatter_utils
 
 
@@ -233,6 +538,22 @@ private:
 }; // class SimpleFormatterOutputSentry
 
 
+//-----------------------------------------------------------------------------
+//! Отступ строк на время жизни объекта
+class SimpleFormatterIndentSentry
+{
+public:
+    SimpleFormatterIndentSentry( SimpleFormatter &simpleFormatter, int n = 4 );
+    ~SimpleFormatterIndentSentry();
+private:
+    // disable copying
+    SimpleFormatterIndentSentry(const SimpleFormatterIndentSentry&);
+    SimpleFormatterIndentSentry& operator=(const SimpleFormatterIndentSentry&);
+
+    SimpleFormatter &m_simpleFormatter;
+}; // class SimpleFormatterIndentSentry
+
+
 
 
 enum class ColoringLevel
@@ -256,6 +577,142 @@ enum class ColoringLevel
 
 
 
+//-----------------------------------------------------------------------------
+//! Минимальный уровень важности (наименее важный) сообщений, которые компилируются
+/*! Задается именем элемента ColoringLevel: -DUMBA_LOG_MIN_LEVEL=info.
+    Сообщения UMBA_LOG менее важных уровней вырождаются в if(false), и ни сами
+    сообщения, ни их аргументы не вычисляются и удаляются компилятором
+ */
+#if !defined(UMBA_LOG_MIN_LEVEL)
+    #define UMBA_LOG_MIN_LEVEL debug
+#endif
+
+namespace log_utils
+{
+
+//-----------------------------------------------------------------------------
+//! Приводит уровень раскраски к уровню важности emergency..debug
+/*! Уровни, не являющиеся уровнями важности (good, caption, normal, ...), приравниваются к близким по смыслу
+ */
+constexpr
+ColoringLevel severity( ColoringLevel lvl )
+{
+    return (unsigned)lvl <= (unsigned)ColoringLevel::debug  ? lvl
+         : lvl == ColoringLevel::good_but_warning           ? ColoringLevel::warning
+         : lvl == ColoringLevel::good_but_notice            ? ColoringLevel::notice
+         : ColoringLevel::info
+         ;
+}
+
+//-----------------------------------------------------------------------------
+//! Сообщения уровня lvl компилируются (см. UMBA_LOG_MIN_LEVEL)
+constexpr
+bool isLevelCompiled( ColoringLevel lvl )
+{
+    return (unsigned)severity(lvl) <= (unsigned)severity(ColoringLevel::UMBA_LOG_MIN_LEVEL);
+}
+
+} // namespace log_utils
+
+
+
+//-----------------------------------------------------------------------------
+//! Поставщик префикса строки (уровень, идентификатор потока и т.п.) - см. SimpleFormatter::setLinePrefixProvider
+/*! Префикс запрашивается перед выводом первого символа каждой строки. Поставщик должен возвращать
+    заранее сформированные байты (а не форматировать их при каждом вызове). Указатель должен
+    оставаться действительным до следующего вызова
+ */
+struct ILinePrefixProvider
+{
+    virtual ~ILinePrefixProvider() {}
+
+    //! lvl - наиболее важный уровень, заданный в строке до первого символа (ColoringLevel::normal, если не задавался - сброс цвета normal уровня не задает)
+    virtual void getLinePrefix( ColoringLevel lvl, const char *&pPrefix, size_t &prefixLen ) = 0;
+
+}; // struct ILinePrefixProvider
+
+//-----------------------------------------------------------------------------
+//! Префикс строки - тег уровня сообщения: "[ERR] ", "[DBG] ". Для строк без уровня префикс пустой
+class LevelTagLinePrefixProvider : public ILinePrefixProvider
+{
+public:
+
+    virtual void getLinePrefix( ColoringLevel lvl, const char *&pPrefix, size_t &prefixLen ) override
+    {
+        static const char* const tags[] = { "[EMG] ", "[ALR] ", "[CRT] ", "[ERR] ", "[WRN] ", "[NTC] ", "[INF] ", "[DBG] " };
+        const size_t tagLen = 6;
+
+        if ((unsigned)lvl > (unsigned)ColoringLevel::debug)
+        {
+            prefixLen = 0;
+            return;
+        }
+
+        pPrefix   = tags[(unsigned)lvl];
+        prefixLen = tagLen;
+    }
+
+}; // class LevelTagLinePrefixProvider
+
+
+
+//-----------------------------------------------------------------------------
+//! Дополнительный интерфейс устройства вывода, которое может ссылаться на данные без копирования
+/*! Данные, переданные в writeStableBuf, не изменяются и остаются действительными как минимум до сброса
+    устройства (строковые литералы, статические таблицы, постоянный префикс строк). Устройство
+    регистрируется в форматтере вызовом SimpleFormatter::setStableBufWriter
+ */
+struct IStableBufWriter
+{
+    virtual ~IStableBufWriter() {}
+
+    virtual void writeStableBuf( const uint8_t *pBuf, size_t len ) = 0;
+
+}; // struct IStableBufWriter
+
+
+
+//-----------------------------------------------------------------------------
+//! Политика сброса (flush) устройства вывода по запросу (SimpleFormatter::requestFlush, omanip::endl)
+enum class FlushPolicy
+{
+    perLine,       //!< сброс на каждый перевод строки (по умолчанию, как раньше)
+    perBytes,      //!< сброс, если с предыдущего сброса выведено не менее заданного количества байт
+    perInterval,   //!< сброс, если с предыдущего сброса прошло не менее заданного количества миллисекунд
+    explicitOnly   //!< только явный сброс - SimpleFormatter::flush(), omanip::flush
+};
+
+//! Источник времени для FlushPolicy::perInterval - монотонные миллисекунды (например, HAL_GetTick)
+typedef uint32_t (*FlushTickSource)();
+
+#if !defined(UMBA_MCU_USED)
+//! Источник времени по умолчанию для хоста - std::chrono::steady_clock
+uint32_t flushTickSourceSteadyClock();
+#endif
+
+
+//-----------------------------------------------------------------------------
+//! Действие при переполнении очереди неблокирующего режима (см. SimpleFormatter::setNonBlockMode)
+enum class NonBlockOverflowPolicy
+{
+    drop,      //!< операция вывода, которая не помещается в устройство и очередь, отбрасывается целиком - ничего из нее не выводится
+    truncate,  //!< в очередь помещается столько, сколько влезает, остаток отбрасывается
+    block      //!< ожидание освобождения очереди (не использовать в прерываниях и потоках реального времени)
+};
+
+//-----------------------------------------------------------------------------
+//! Счетчики неблокирующего режима
+struct NonBlockStats
+{
+    size_t  droppedBytes    = 0;  //!< отброшено байт (drop, truncate)
+    size_t  droppedWrites   = 0;  //!< операций вывода, отброшенных целиком (drop)
+    size_t  truncatedWrites = 0;  //!< операций вывода, сохраненных в очереди частично (truncate)
+    size_t  blockedWrites   = 0;  //!< операций вывода, ожидавших освобождения очереди (block)
+    size_t  maxQueued       = 0;  //!< наибольшая заполненность очереди
+};
+
+
+
 //-----------------------------------------------------------------------------
 namespace omanip
 {
@@ -306,6 +763,30 @@ namespace omanip
 
     }; // struct IntManipHelper
 
+    //! Строка для вывода с экранированием в стиле C (см. omanip::escaped)
+    struct EscapedStringManipHelper
+    {
+        const char     *m_str;
+        std::size_t     m_len;
+
+    }; // struct EscapedStringManipHelper
+
+    //! Неизменяемая строка со статическим временем жизни (см. omanip::literal)
+    struct StableStringManipHelper
+    {
+        const char     *m_str;
+        std::size_t     m_len;
+
+    }; // struct StableStringManipHelper
+
+    //! Отложенное значение - Callable вызывается только если вывод разрешен (см. omanip::lazy)
+    template<typename Callable>
+    struct LazyValue
+    {
+        Callable        m_fn;
+
+    }; // struct LazyValue
+
 
 } // namespace omanip
 
@@ -338,26 +819,110 @@ public:
     static const FormatFlags   uppercasebase = 0x0200; //!< used with showbase
     static const FormatFlags   uppercaseall  = 0x0300; //!< uppercase|uppercasebase
     static const FormatFlags   fmtauto       = 0x0400; //!< автоматическое форматирование 8,16ти-ричных, двоичных чисел и указателей. Ширина выбирется в зависимости от размера типа, fill - '0', символы - uppercase, префикс - lowercase (указатели без префикса). Также, для целых чисел, если указан флаг showpos, для нуля знак не будет выводится
+    static const FormatFlags   ellipsis      = 0x0800; //!< строка, обрезанная по maxLength, завершается многоточием "..." (входит в maxLength)
 
     static const FormatFlags   fixed         = 0x1000; //!< если задан, то выводится фиксированное количество цифр после запятой, как задано в precision (по умолчанию - 3). Если не задан, то незначащие нули опускаются, а отображением десятичной точки управляет showpoint
     static const FormatFlags   scientific    = 0x2000; //!< не используется, задано для совместимости с std::iostreams
     static const FormatFlags   floatfield    = 0x3000; //!< маска
+    static const FormatFlags   bytewidth     = 0x4000; //!< ширина строк при выравнивании считается в байтах. По умолчанию - в позициях терминала (UTF-8, широкие и комбинируемые символы)
 
     //-------------------
+    //! Состояние форматирования
+    /*! Поля упакованы в поля минимальной разрядности (16 байт вместо 28), т.к. состояние
+        копируется при сохранении/восстановлении и передается в функции форматирования.
+        Все флаги помещаются в 16 бит; precision ограничивается при выводе 12ю знаками,
+        размер группы разрядов не превышает разрядности самого длинного числа
+     */
     struct FormatState
     {
-        FormatFlags flags     = dec | right | fmtauto | showbase | uppercase; // default
+        uint16_t    flags     = dec | right | fmtauto | showbase | uppercase; // default
+        int16_t     precision = 3; // 3 digits after decimal point
         int         width     = 0; // width - auto
-        int         precision = 3; // 3 digits after decimal point
         char        fill      = ' ';
         char        decGroupSep = '\'';//'`';
         char        groupSep = '\'';
-        int         decGroupSize = 0;
-        int         groupSize = 4;
         char        decimalPoint = '.';
+        int8_t      decGroupSize = 0;
+        int8_t      groupSize = 4;
+        int         maxLength = 0; // max string length - unlimited
 
     }; // struct FormatState
 
+    //! Все флаги форматирования - новый флаг нужно добавить сюда
+    static const FormatFlags   allFlags      = basefield | adjustfield | boolalpha | showbase | showpoint | showpos
+                                             | uppercaseall | fmtauto | ellipsis | floatfield | bytewidth;
+
+    static_assert( allFlags == (FormatFlags)(decltype(FormatState::flags))allFlags, "FormatState::flags is too narrow for FormatFlags - widen the field" );
+
+    //-------------------
+    //! Биты маски измененных полей FormatState (см. saveFormatState/restoreFormatState)
+    static const unsigned      stateFieldFlags        = 0x0001;
+    static const unsigned      stateFieldWidth        = 0x0002;
+    static const unsigned      stateFieldPrecision    = 0x0004;
+    static const unsigned      stateFieldFill         = 0x0008;
+    static const unsigned      stateFieldDecGroupSep  = 0x0010;
+    static const unsigned      stateFieldGroupSep     = 0x0020;
+    static const unsigned      stateFieldDecGroupSize = 0x0040;
+    static const unsigned      stateFieldGroupSize    = 0x0080;
+    static const unsigned      stateFieldDecimalPoint = 0x0100;
+    static const unsigned      stateFieldMaxLength    = 0x0200;
+    static const unsigned      stateFieldAll          = 0x03FF;
+
+    //-------------------
+    //! Состояние форматирования, заданное во время компиляции (см. umba::spec)
+    /*! Поля - константы времени компиляции, поэтому для каждой спецификации инстанцируется
+        своя версия formatUnsigned/formatSignedValue/... без ветвлений по флагам.
+        Параметры группировки разрядов и десятичная точка - как в FormatState по умолчанию
+     */
+    template< FormatFlags Flags, int Width = 0, char Fill = ' ', int Precision = 3 >
+    struct FormatSpec
+    {
+        static constexpr FormatFlags flags        = Flags;
+        static constexpr int         width        = Width;
+        static constexpr int         precision    = Precision;
+        static constexpr char        fill         = Fill;
+        static constexpr char        decGroupSep  = '\'';
+        static constexpr char        groupSep     = '\'';
+        static constexpr int         decGroupSize = 0;
+        static constexpr int         groupSize    = 4;
+        static constexpr char        decimalPoint = '.';
+        static constexpr int         maxLength    = 0;
+
+    }; // struct FormatSpec
+
+    //-------------------
+    //! Спецификация Spec с примененным fmtauto для целого разрядности NumBits (аналог applyAutoFormat)
+    template< typename Spec, unsigned NumBits >
+    struct FormatSpecAuto
+    {
+        static constexpr FormatFlags specBase     = Spec::flags & basefield;
+        static constexpr bool        isAuto       = specBase!=dec && (Spec::flags&fmtauto)!=0;
+        static constexpr int         autoDigits   = specBase==bin ? (int)NumBits : (specBase==oct ? (int)NumBits/3 : (int)NumBits/4);
+        static constexpr int         autoSeps     = Spec::groupSize>0 ? autoDigits/Spec::groupSize - ((autoDigits%Spec::groupSize)==0 ? 1 : 0) : 0;
+        static constexpr int         autoPrefix   = (Spec::flags&showbase) ? 2 : 0;
+
+        static constexpr FormatFlags flags        = isAuto ? (Spec::flags|uppercase) : Spec::flags;
+        static constexpr int         width        = isAuto ? autoDigits + autoSeps + autoPrefix : Spec::width;
+        static constexpr int         precision    = Spec::precision;
+        static constexpr char        fill         = isAuto ? '0' : Spec::fill;
+        static constexpr char        decGroupSep  = Spec::decGroupSep;
+        static constexpr char        groupSep     = Spec::groupSep;
+        static constexpr int         decGroupSize = Spec::decGroupSize;
+        static constexpr int         groupSize    = Spec::groupSize;
+        static constexpr char        decimalPoint = Spec::decimalPoint;
+        static constexpr int         maxLength    = Spec::maxLength;
+
+    }; // struct FormatSpecAuto
+
+    //-------------------
+    //! Значение, выводимое со спецификацией формата Spec
+    template< typename Spec, typename T >
+    struct FormatSpecValue
+    {
+        T value;
+
+    }; // struct FormatSpecValue
+
     //-------------------
     SimpleFormatter(ICharWriter *charWriter);
     explicit SimpleFormatter();
@@ -373,6 +938,9 @@ public:
     int width( int w );
     int precision() const;
     int precision( int p );
+    //! Максимальная длина выводимой строки в байтах, 0 - без ограничения. На числа не влияет
+    int maxlength() const;
+    int maxlength( int len );
     char fill() const;
     char fill( char c );
     int base() const;
@@ -451,6 +1019,8 @@ public:
     UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL(uppercase    )
     UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL(uppercasebase)
     UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL(uppercaseall )
+    UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL(ellipsis     )
+    UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL(bytewidth    )
     // UMBA_SIMPLE_FORMATTER_SET_FORMAT_FLAG_IMPL()
 
 
@@ -463,12 +1033,114 @@ public:
     void pushLock( bool disableOutput = true );
     void popLock();
 
+    //! Установка политики сброса. param - количество байт для perBytes или интервал в миллисекундах для perInterval
+    void setFlushPolicy( FlushPolicy policy, uint32_t param = 0 );
+    FlushPolicy getFlushPolicy() const;
+    //! Источник времени для perInterval. Для хоста по умолчанию используется std::chrono::steady_clock, для MCU его нужно задать
+    void setFlushTickSource( FlushTickSource tickSource );
+    //! Сообщения уровня lvl и более важные сбрасываются немедленно, независимо от политики (по умолчанию - error)
+    void setFlushLevel( ColoringLevel lvl );
+    //! Постоянный префикс каждой строки (ASCII-Z, строка не копируется и должна оставаться действительной). 0 - без префикса
+    void setLinePrefix( const char *prefix );
+    //! Поставщик префикса, выводимого перед постоянным префиксом. 0 - без поставщика
+    void setLinePrefixProvider( ILinePrefixProvider *pProvider );
+    //! Увеличение отступа строк на n пробелов (отступ выводится после префикса)
+    void pushIndent( int n = 4 );
+    void popIndent();
+    int getIndent() const;
+
+    //! Запрос сброса - решение принимается в соответствии с политикой. lineEnd - запрос в конце строки сообщения
+    /*! Вызов с lineEnd=false можно использовать для периодического опроса (например, в цикле ожидания),
+        чтобы при политике perInterval данные не задерживались до следующей строки
+     */
+    void requestFlush( bool lineEnd = true );
+
+    //! Неблокирующий режим: устройству передается не больше, чем оно принимает без блокировки (ICharWriter::getNonBlockMax)
+    /*! Остаток выводится в кольцевую очередь pQueueBuf размером queueSize (буфер не копируется и должен оставаться
+        действительным), очередь выводится при последующих операциях вывода и в pumpNonBlock().
+        При переполнении очереди действует policy. pQueueBuf==0 - выключение режима (очередь выводится с блокировкой).
+
+        Переводы строк выводятся байтами ("\r\n" для MCU/Windows в двоичном режиме, иначе "\n"), а не методами
+        устройства putEndl/putCR/putFF. Смена цвета и сброс устройства, запрошенные при непустой очереди,
+        откладываются и выполняются в pumpNonBlock(), когда будут выведены данные, стоявшие в очереди перед ними.
+        Отложенных смен цвета - не более nonBlockMaxPendingColors; при большем числе последняя заменяется новой.
+        Перемещение в начало строки и очистка до конца строки (методы getCharWritter()) при непустой очереди
+        выводятся через очередь байтами ("\r", ESC [ K - только для ANSI-терминалов). Прочие терминальные
+        методы выполняются устройством сразу и могут обогнать данные в очереди
+     */
+    void setNonBlockMode( uint8_t *pQueueBuf, size_t queueSize, NonBlockOverflowPolicy policy = NonBlockOverflowPolicy::drop );
+    //! Количество смен цвета, которые могут быть отложены в неблокирующем режиме
+    static const unsigned nonBlockMaxPendingColors = 4;
+
+    bool isNonBlockMode() const
+    {
+        return m_nbQueue!=0;
+    }
+    //! Вывод из очереди без блокировки. Возвращает количество байт, оставшихся в очереди
+    size_t pumpNonBlock();
+    size_t getNonBlockQueued() const
+    {
+        return m_nbCount;
+    }
+    const NonBlockStats& getNonBlockStats() const
+    {
+        return m_nbStats;
+    }
+    void resetNonBlockStats()
+    {
+        m_nbStats = NonBlockStats();
+    }
+
+    //! Устройство, принимающее ссылки на неизменяемые данные - обычно тот же объект, что и устройство вывода. 0 - не использовать
+    /*! Сбрасывается при смене устройства вывода (setCharWritter)
+     */
+    void setStableBufWriter( IStableBufWriter *pStableWriter )
+    {
+        m_pStableWriter = pStableWriter;
+    }
+    //! Вывод данных со статическим временем жизни - передаются устройству по ссылке, если оно это поддерживает
+    void writeStableBuf( const char *pBuf, size_t sz );
+
+    //! Возвращает false, если вывод заблокирован (pushLock(true)). Дорогие вычисления для вывода можно пропускать
+    bool isOutputEnabled() const
+    {
+        return !m_disableOutput;
+    }
+
+    //! Уровень фильтрации сообщений UMBA_LOG времени выполнения - наименее важный выводимый уровень
+    ColoringLevel logLevel() const
+    {
+        return m_logLevel;
+    }
+
+    ColoringLevel logLevel( ColoringLevel lvl )
+    {
+        ColoringLevel res = m_logLevel;
+        m_logLevel = log_utils::severity(lvl);
+        return res;
+    }
+
+    //! Проверка уровня сообщения перед форматированием - одно сравнение
+    bool isLogLevelEnabled( ColoringLevel lvl ) const
+    {
+        return (unsigned)log_utils::severity(lvl) <= (unsigned)m_logLevel;
+    }
+
 
     unsigned getColor(ColoringLevel lvl);
     void setColor(ColoringLevel lvl, umba::term::colors::SgrColor clr );
     void coloring( ColoringLevel lvl );
     void coloring( umba::term::colors::SgrColor clr );
 
+    //! Сбрасывает запомненный текущий цвет - следующая смена цвета будет выведена безусловно
+    /*! Нужно вызывать, если цвет терминала мог быть изменен в обход SimpleFormatter
+     */
+    void invalidateColorCache()
+    {
+        m_curColorValid   = false;
+        m_colorsSupported = -1;
+    }
+
 
     // for iomanips - each manip must call saveFormatState
     void saveFormatState();
@@ -485,8 +1157,8 @@ public:
     // https://habr.com/post/54762/
 
     //-------------------
-    template<typename T > 
-    void formatUnsigned( T val, const FormatState fmtState )
+    template<typename T, typename StateType > 
+    void formatUnsigned( T val, const StateType &fmtState )
     {
         char numBuf[ 2 * format_utils::integral_max_bits ];
 
@@ -513,6 +1185,14 @@ public:
                                                         , grpSepCounter, digitsCounter
                                                         );
         
+        writeAlignedNumber( prefix, prefixLen, numBuf, numStrLen, fmtState );
+    }
+
+    //-------------------
+    //! Вывод префикса (знак, основание) и тела числа с выравниванием по ширине
+    template<typename StateType >
+    void writeAlignedNumber( const char *prefix, int prefixLen, const char *numBuf, int numStrLen, const StateType &fmtState )
+    {
         int totalWidth = numStrLen + prefixLen;
         int fillW      = fmtState.width - totalWidth;
         FormatFlags align = fmtState.flags & adjustfield;
@@ -541,6 +1221,77 @@ public:
            }
     }
 
+    //-------------------
+    //! Автоматическое форматирование (fmtauto) для не десятичных оснований: ширина по разрядности numBits, заполнение нулями
+    void applyAutoFormat( FormatState &uintFmt, unsigned numBits ) const
+    {
+        // автоматическое форматирование 8,16ти-ричных, двоичных чисел.
+        // Ширина выбирется в зависимости от размера типа, fill - '0', символы - uppercase, 
+        // префикс - lowercase (указатели без префикса)
+
+        //uintFmt.flags |= showbase;
+        uintFmt.flags |= uppercase;
+
+        int fmtBase = baseFromFlags(uintFmt.flags);
+        int widthNumDigits = 0;
+        int prefixLen = 0;
+        
+        switch(fmtBase)
+           {
+            case 2:
+                 //uintFmt.width = (int)numBits + 2; 
+                 widthNumDigits = (int)numBits;
+                 prefixLen = 2; // prefix '0b' len - 2
+                 break;
+            case 8:
+                 //uintFmt.width = (int)numBits/3 + 1; // prefix '0' len - 1
+                 widthNumDigits = (int)numBits/3;
+                 prefixLen = 2; // prefix '0' len - 1
+                 break;
+            default:
+                 //uintFmt.width = (int)numBits/4 + 2; // prefix '0x' len - 2
+                 widthNumDigits = (int)numBits/4;
+                 prefixLen = 2; // prefix '0x' len - 2
+           }
+
+        if (!(uintFmt.flags & showbase))
+            prefixLen = 0;
+
+        int numSeps = 0;
+        if (uintFmt.groupSize>0)
+        {
+            numSeps = widthNumDigits / uintFmt.groupSize;
+            if ((widthNumDigits%uintFmt.groupSize) == 0 /* numSeps*uintFmt.groupSize */ )
+                numSeps -= 1;
+        }
+        uintFmt.width = widthNumDigits + numSeps + prefixLen;
+
+        uintFmt.fill = '0';
+    }
+
+    //-------------------
+    //! Вывод беззнакового целого с заданным состоянием форматирования (с учетом fmtauto)
+    template<typename T > 
+    void formatUnsignedValue( T val, const FormatState &fmtState )
+    {
+
+        FormatState uintFmt = fmtState;
+
+        if ( ((uintFmt.flags&basefield) != dec) && (uintFmt.flags&fmtauto) )
+            applyAutoFormat( uintFmt, (unsigned)(sizeof(T)*CHAR_BIT) );
+
+        formatUnsigned( val, uintFmt );
+    }
+
+    //-------------------
+    //! Вывод беззнакового целого со спецификацией формата времени компиляции - fmtauto также вычисляется при компиляции
+    template<typename T, FormatFlags Flags, int Width, char Fill, int Precision > 
+    void formatUnsignedValue( T val, const FormatSpec<Flags, Width, Fill, Precision> &fmtSpec )
+    {
+        UMBA_USED(fmtSpec);
+        formatUnsigned( val, FormatSpecAuto< FormatSpec<Flags, Width, Fill, Precision>, (unsigned)(sizeof(T)*CHAR_BIT) >() );
+    }
+
     //-------------------
     template<typename T > 
     typename std::enable_if< std::is_integral<T>::value
@@ -548,69 +1299,146 @@ public:
                            >::type
     formatValue( T val )
     {
+        formatUnsignedValue( val, m_formatState );
+    }
 
-        FormatState uintFmt = m_formatState;
-
-        if ( ((uintFmt.flags&basefield) != dec) && (uintFmt.flags&fmtauto) )
+    //-------------------
+    //! Вывод строки с экранированием в стиле C: \n, \t, \\, \", \ooo и т.п.
+    /*! Участки из печатных ASCII символов находятся SIMD-сканером (format_utils::findCEscapeChar)
+        и выводятся одним writeBuf, посимвольно обрабатываются только экранируемые байты.
+
+        Байты без именованной последовательности выводятся восьмеричной последовательностью из трех цифр
+        (\001, \377): она всегда заканчивается на третьей цифре, в отличие от \xNN, которая поглощает
+        все последующие шестнадцатеричные цифры ("\x01" "AB" читалось бы как один символ \x01AB)
+     */
+    void formatEscapedString( const char *str, std::size_t len )
+    {
+        while(len)
         {
-            // автоматическое форматирование 8,16ти-ричных, двоичных чисел.
-            // Ширина выбирется в зависимости от размера типа, fill - '0', символы - uppercase, 
-            // префикс - lowercase (указатели без префикса)
+            std::size_t runLen = format_utils::findCEscapeChar(str, len);
+            if (runLen)
+            {
+                writeBuf(str, runLen);
+                str += runLen;
+                len -= runLen;
+                if (!len)
+                    break;
+            }
 
-            //uintFmt.flags |= showbase;
-            uintFmt.flags |= uppercase;
+            char esc[4] = { '\\', 0, 0, 0 };
+            std::size_t escLen = 2;
 
-            unsigned numBits = sizeof(T)*CHAR_BIT;
-            int fmtBase = baseFromFlags(uintFmt.flags);
-            int widthNumDigits = 0;
-            int prefixLen = 0;
-            
-            switch(fmtBase)
-               {
-                case 2:
-                     //uintFmt.width = (int)numBits + 2; 
-                     widthNumDigits = (int)numBits;
-                     prefixLen = 2; // prefix '0b' len - 2
-                     break;
-                case 8:
-                     //uintFmt.width = (int)numBits/3 + 1; // prefix '0' len - 1
-                     widthNumDigits = (int)numBits/3;
-                     prefixLen = 2; // prefix '0' len - 1
-                     break;
+            unsigned char ch = (unsigned char)*str;
+            switch(ch)
+            {
+                case '\n': esc[1] = 'n';  break;
+                case '\r': esc[1] = 'r';  break;
+                case '\t': esc[1] = 't';  break;
+                case '\a': esc[1] = 'a';  break;
+                case '\b': esc[1] = 'b';  break;
+                case '\f': esc[1] = 'f';  break;
+                case '\v': esc[1] = 'v';  break;
+                case '\\': esc[1] = '\\'; break;
+                case '"' : esc[1] = '"';  break;
                 default:
-                     //uintFmt.width = (int)numBits/4 + 2; // prefix '0x' len - 2
-                     widthNumDigits = (int)numBits/4;
-                     prefixLen = 2; // prefix '0x' len - 2
-               }
+                     esc[1] = (char)('0' + (ch>>6));
+                     esc[2] = (char)('0' + ((ch>>3)&7));
+                     esc[3] = (char)('0' + (ch&7));
+                     escLen = 4;
+            }
+
+            writeBuf(esc, escLen);
+            ++str;
+            --len;
+        }
+    }
+
+    //-------------------
+    //! Пакетный вывод массива 32х-битных беззнаковых чисел, разделенных строкой sep.
+    /*! Результат побайтно совпадает с поэлементным вызовом formatValue. Для десятичного
+        вывода без группировки разрядов цифры получаются векторным преобразованием
+        (по 4/8 чисел за раз, см. format_utils::formatUInt32DecFixed) и выводятся блоками
+     */
+    void formatValues( const uint32_t *pVals, std::size_t count, const char *sep = " " )
+    {
+        if (m_disableOutput)
+            return;
+
+        std::size_t sepLen = sep ? std::strlen(sep) : 0;
 
-            if (!(uintFmt.flags & showbase))
-                prefixLen = 0;
+        const int maxFastWidth  = 32;
+        const int maxFastSepLen = 16;
 
-            int numSeps = 0;
-            if (uintFmt.groupSize>0)
+        bool fastPath = (m_formatState.flags&basefield)==dec
+                     && m_formatState.decGroupSize<1
+                     && m_formatState.width<=maxFastWidth
+                     && sepLen<=(std::size_t)maxFastSepLen
+                     ;
+
+        if (!fastPath)
+        {
+            for(std::size_t i=0; i!=count; ++i)
             {
-                numSeps = widthNumDigits / uintFmt.groupSize;
-                if ((widthNumDigits%uintFmt.groupSize) == 0 /* numSeps*uintFmt.groupSize */ )
-                    numSeps -= 1;
+                if (i && sepLen)
+                    writeBuf(sep, sepLen);
+                formatValue(pVals[i]);
             }
-            uintFmt.width = widthNumDigits + numSeps + prefixLen;
+            return;
+        }
 
-            uintFmt.fill = '0';
+        char digits[8*10];
+        char outBuf[512];
+        std::size_t outLen = 0;
+
+        for(std::size_t i=0; i!=count; )
+        {
+            std::size_t n = count - i;
+            if (n>8)
+                n = 8;
+
+            format_utils::formatUInt32DecFixed( pVals+i, n, digits );
+
+            for(std::size_t j=0; j!=n; ++j, ++i)
+            {
+                if (outLen > sizeof(outBuf) - (std::size_t)(maxFastWidth+maxFastSepLen))
+                {
+                    writeBuf(outBuf, outLen);
+                    outLen = 0;
+                }
+
+                if (i && sepLen)
+                {
+                    std::memcpy(&outBuf[outLen], sep, sepLen);
+                    outLen += sepLen;
+                }
+
+                // Как и в formatUnsigned, заполнитель всегда выводится слева от числа
+                int numDigits = format_utils::countUInt32DecDigits(pVals[i]);
+                int fillW     = m_formatState.width - numDigits;
+                if (fillW>0)
+                {
+                    std::memset(&outBuf[outLen], m_formatState.fill, (std::size_t)fillW);
+                    outLen += (std::size_t)fillW;
+                }
+
+                std::memcpy(&outBuf[outLen], &digits[j*10 + (std::size_t)(10-numDigits)], (std::size_t)numDigits);
+                outLen += (std::size_t)numDigits;
+            }
         }
 
-        formatUnsigned( val, uintFmt );
+        if (outLen)
+            writeBuf(outBuf, outLen);
     }
 
     //-------------------
-    template<typename T > 
-    typename std::enable_if< std::is_integral<T>::value
-                          && std::is_signed<T>::value
-                           >::type
-    formatValue( T val )
+    //! Вывод знакового целого с заданным состоянием форматирования. Не десятичные основания выводятся как беззнаковые
+    template<typename T, typename StateType > 
+    void formatSignedValue( T val, const StateType &fmtState )
     {
-        if (base()!=10)
+        int fmtBase = baseFromFlags(fmtState.flags);
+        if (fmtBase!=10)
         {
-            formatValue( typename std::make_unsigned<T>::type(val) );
+            formatUnsignedValue( (typename format_utils::make_unsigned_ext<T>::type)val, fmtState );
             return;
         }
 
@@ -625,20 +1453,20 @@ public:
         {
             showSign = true;
         }
-        else if (m_formatState.flags & showpos)
+        else if (fmtState.flags & showpos)
         {
             // автоматическое форматирование целых - если указан флаг showpos, для нуля знак не будет выводится
-            if ( val!=0 || !(m_formatState.flags & fmtauto) )
+            if ( val!=0 || !(fmtState.flags & fmtauto) )
             {
                 showSign = true;
                 sign = '+';
             }
         }
 
-        int numStrLen = (int)format_utils::formatIntImpl( val, base(), false, numBuf
+        int numStrLen = (int)format_utils::formatIntImpl( val, fmtBase, false, numBuf
                                                         , 0 /* width*/, ' ' /* fillCh */
-                                                        , m_formatState.decGroupSize
-                                                        , m_formatState.decGroupSep
+                                                        , fmtState.decGroupSize
+                                                        , fmtState.decGroupSep
                                                         , grpSepCounter
                                                         , digitsCounter
                                                         );
@@ -647,8 +1475,8 @@ public:
         if (showSign)
             totalWidth++;
 
-        int fillW = m_formatState.width - totalWidth;
-        FormatFlags align = m_formatState.flags & adjustfield;
+        int fillW = fmtState.width - totalWidth;
+        FormatFlags align = fmtState.flags & adjustfield;
 
         switch(align)
            {
@@ -656,11 +1484,11 @@ public:
                  if (showSign)
                      writeBuf(&sign, 1);
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  break;
 
             case right:
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  if (showSign)
                      writeBuf(&sign, 1);
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
@@ -669,21 +1497,106 @@ public:
             default: // internal
                  if (showSign)
                      writeBuf(&sign, 1);
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
            }
     }
 
     //-------------------
-    template<typename T >
-    typename std::enable_if< std::is_floating_point<T>::value >::type
+    template<typename T > 
+    typename std::enable_if< std::is_integral<T>::value
+                          && std::is_signed<T>::value
+                           >::type
     formatValue( T val )
     {
-        bool isUpper = m_formatState.flags&uppercase ? true : false;
+        formatSignedValue( val, m_formatState );
+    }
+
+    #if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+
+    //-------------------
+    // Не шаблонные перегрузки - в строгом режиме стандарта std::is_integral для 128ми-битных типов дает false
+    void formatValue( format_utils::uint128_t val )
+    {
+        formatUnsignedValue( val, m_formatState );
+    }
+
+    //-------------------
+    void formatValue( format_utils::int128_t val )
+    {
+        formatSignedValue( val, m_formatState );
+    }
+
+    #endif
+
+    #if !defined(UMBA_MCU_USED)
+
+    //-------------------
+    //! Вывод целого произвольной разрядности (см. umba::bigint_view). Знак выводится при любом основании
+    /*! Десятичное число заполняется до ширины так же, как встроенные знаковые целые (formatSignedValue):
+        заполнитель (и '0') ставится по выравниванию - перед знаком для right, между знаком и цифрами
+        только для internal. Для прочих оснований, как для встроенных беззнаковых, заполнение '0'
+        является частью числа и ставится после знака и префикса основания
+     */
+    template<typename LimbType>
+    void formatValue( const format_utils::BigIntView<LimbType> &val )
+    {
+        FormatState fmtState = m_formatState;
+        int fmtBase = baseFromFlags(fmtState.flags);
+
+        if (fmtBase!=10 && (fmtState.flags&fmtauto))
+            applyAutoFormat( fmtState, (unsigned)(val.count*sizeof(LimbType)*CHAR_BIT) );
+
+        std::string digits = format_utils::bigIntToDigits( val, fmtBase, format_utils::getDigitChars((fmtState.flags&uppercase) ? true : false) );
+        bool isZero = digits.size()==1 && digits[0]=='0';
+
+        std::string prefix;
+        if (val.negative && !isZero)
+        {
+            prefix.push_back('-');
+        }
+        else if (fmtState.flags & showpos)
+        {
+            // как и для встроенных целых - при fmtauto для нуля знак не выводится
+            if ( !isZero || !(fmtState.flags & fmtauto) )
+                prefix.push_back('+');
+        }
+
+        if (fmtBase!=10 && (fmtState.flags&showbase))
+            prefix.append( getUnsignedPrefix( fmtState.flags, fmtState.flags&uppercasebase ? true : false ) );
+
+        int  prefixLen = (int)prefix.size();
+        int  groupSize = fmtBase==10 ? fmtState.decGroupSize : fmtState.groupSize;
+        char groupSep  = fmtBase==10 ? fmtState.decGroupSep  : fmtState.groupSep;
+
+        int grpSepCounter = 0;
+        int digitsCounter = 0;
+
+        std::vector<char> numBuf( digits.size()*2 + (std::size_t)(fmtState.width>0 ? fmtState.width : 0) + 1 );
+
+        int digitsWidth = fmtBase==10 ? 0 : fmtState.width - prefixLen;
+
+        int numStrLen = (int)format_utils::formatUnsignedDigits( digits.data(), (int)digits.size(), &numBuf[0]
+                                                               , digitsWidth, fmtState.fill
+                                                               , groupSize, groupSep
+                                                               , grpSepCounter, digitsCounter
+                                                               );
+
+        writeAlignedNumber( prefix.data(), prefixLen, &numBuf[0], numStrLen, fmtState );
+    }
+
+    #endif
+
+    //-------------------
+    //! Вывод числа с плавающей точкой с заданным состоянием форматирования
+    template<typename T, typename StateType >
+    void formatFloatValue( T val, const StateType &fmtState )
+    {
+        bool isUpper = fmtState.flags&uppercase ? true : false;
 
         if (std::isnan(val))
         {
-            formatValue( getNanStr(isUpper) );
+            formatStringBuf( getNanStr(isUpper), 3, fmtState );
             return;
         }
 
@@ -709,7 +1622,7 @@ public:
         {
             pStrNum = numBuf;
 
-            int prec = m_formatState.precision;
+            int prec = fmtState.precision;
             if (prec<0)
                 prec = -prec;
             if (prec>12)
@@ -755,12 +1668,12 @@ public:
             size_t fractionPartBeginIdx  = 1;
             size_t intPartBeginIdx = (std::size_t)(prec + 1);
 
-            if (!(m_formatState.flags&fixed))
+            if (!(fmtState.flags&fixed))
             {
                 // Отбрасываем незначащие нули
                 // Не надо
-                //m_formatState.width
-                // if (m_formatState.precision)
+                //fmtState.width
+                // if (fmtState.precision)
                 // while( (fixedPointDigits[fractionPartBeginIdx]==0) && (fractionPartBeginIdx!=intPartBeginIdx) )
                 //     fractionPartBeginIdx++;
             }
@@ -779,13 +1692,13 @@ public:
                 */
                 {
                     
-                    if (m_formatState.flags&showpoint)
+                    if (fmtState.flags&showpoint)
                     {
                         // force show point
                         if (prec>0) // если точность задана нулевая, точку не отображаем
                         {
                             *pStrNumCurPos++ = '0';
-                            *pStrNumCurPos++ = m_formatState.decimalPoint;
+                            *pStrNumCurPos++ = fmtState.decimalPoint;
                         }
                     }
                     else
@@ -800,18 +1713,18 @@ public:
                 {
                     *pStrNumCurPos++ = '0' + fixedPointDigits[fractionPartBeginIdx];
                 }
-                *pStrNumCurPos++ = m_formatState.decimalPoint;
+                *pStrNumCurPos++ = fmtState.decimalPoint;
             }
 
             // форматируем целую часть
 
-           int groupSize = m_formatState.decGroupSize;
+           int groupSize = fmtState.decGroupSize;
            if (groupSize<1)
               groupSize = 0;
 
            int grpSepCounter = 0;
            int intPartDigitsCounter = 0;
-           char groupSep = m_formatState.decGroupSep;
+           char groupSep = fmtState.decGroupSep;
 
            //while(fixedPointDigits[intPartBeginIdx])
            while(intPartBeginIdx!=numDigits)
@@ -827,7 +1740,7 @@ public:
                intPartDigitsCounter++;
            }
 
-           //if (!intPartDigitsCounter && ( !hasVisibleFractionPart || (m_formatState.flags&fixed) ) )
+           //if (!intPartDigitsCounter && ( !hasVisibleFractionPart || (fmtState.flags&fixed) ) )
            if (!intPartDigitsCounter )
            {
                *pStrNumCurPos++ = '0';
@@ -844,10 +1757,10 @@ public:
         {
             showSign = true;
         }
-        else if (m_formatState.flags & showpos)
+        else if (fmtState.flags & showpos)
         {
             // автоматическое форматирование целых - если указан флаг showpos, для нуля знак не будет выводится
-            if ( bZero || !(m_formatState.flags & fmtauto) )
+            if ( bZero || !(fmtState.flags & fmtauto) )
             {
                 showSign = true;
                 sign = '+';
@@ -860,8 +1773,8 @@ public:
         if (showSign)
             totalWidth++;
 
-        int fillW = m_formatState.width - totalWidth;
-        FormatFlags align = m_formatState.flags & adjustfield;
+        int fillW = fmtState.width - totalWidth;
+        FormatFlags align = fmtState.flags & adjustfield;
 
         switch(align)
            {
@@ -869,11 +1782,11 @@ public:
                  if (showSign)
                      writeBuf(&sign, 1);
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  break;
 
             case right:
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  if (showSign)
                      writeBuf(&sign, 1);
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
@@ -882,10 +1795,18 @@ public:
             default: // internal
                  if (showSign)
                      writeBuf(&sign, 1);
-                 makeFill( fillW, m_formatState.fill );
+                 makeFill( fillW, fmtState.fill );
                  writeBuf((const uint8_t*)numBuf, (unsigned)numStrLen);
            }
     }
+    //-------------------
+    template<typename T >
+    typename std::enable_if< std::is_floating_point<T>::value >::type
+    formatValue( T val )
+    {
+        formatFloatValue( val, m_formatState );
+    }
+
 /*
 
     static const FormatFlags   showpoint     = 0x0040; //!< generate a decimal-point character unconditionally for floating-point number output
@@ -960,35 +1881,222 @@ public:
 */
 
     //-------------------
-    void formatValue( const char* str )
+    //! Вывод строки известной длины с выравниванием по ширине (без ограничения maxLength)
+    /*! Ширина строки считается в позициях терминала (см. format_utils::utf8DisplayWidth), если не задан флаг bytewidth.
+        Без заданной ширины поля строка не сканируется
+     */
+    template<typename StateType >
+    void formatStringBuf( const char* str, std::size_t strLen, const StateType &fmtState, const char *pTail = 0, std::size_t tailLen = 0 )
     {
-        int strLen = 0;
-        if (str)
-            strLen = (int)std::strlen(str);
+        int fillW = 0;
+        if (fmtState.width>0)
+        {
+            std::size_t strW = (fmtState.flags&bytewidth) ? strLen : format_utils::utf8DisplayWidth(str, strLen);
+            fillW = fmtState.width - (int)(strW + tailLen);
+        }
 
-        int fillW = m_formatState.width - strLen;
+        FormatFlags align = fmtState.flags & adjustfield;
 
-        FormatFlags align = m_formatState.flags & adjustfield;
+        if (align!=left)  // right, internal
+             makeFill( fillW, fmtState.fill );
+
+        if (strLen)
+            writeBuf((const uint8_t*)str, strLen);
+        if (tailLen)
+            writeBuf((const uint8_t*)pTail, tailLen);
 
         if (align==left)
+             makeFill( fillW, fmtState.fill );
+    }
+
+    //-------------------
+    //! Вывод строки с заданным состоянием форматирования
+    /*! Если задан maxLength, длина строки ищется не далее maxLength+1 байт, поэтому вывод огромной строки
+        стоит O(maxLength), а не O(длина строки). Обрезка не разрывает символы UTF-8.
+        maxScanLen - известная верхняя граница длины (например, size() для std::string)
+     */
+    template<typename StateType >
+    void formatStringValue( const char* str, const StateType &fmtState, std::size_t maxScanLen = (std::size_t)-1 )
+    {
+        if (!str)
         {
-             if (strLen)
-                 writeBuf((const uint8_t*)str, (std::size_t)strLen);
-             makeFill( fillW, m_formatState.fill );
+            formatStringBuf( str, 0, fmtState );
+            return;
         }
-        else // right, internal 
+
+        if (fmtState.maxLength<=0)
         {
-             makeFill( fillW, m_formatState.fill );
-             if (strLen)
-                 writeBuf((const uint8_t*)str, (std::size_t)strLen);
+            std::size_t strLen = maxScanLen==(std::size_t)-1 ? std::strlen(str) : format_utils::boundedStrLen(str, maxScanLen);
+            formatStringBuf( str, strLen, fmtState );
+            return;
+        }
+
+        std::size_t maxLen  = (std::size_t)fmtState.maxLength;
+        std::size_t scanLen = maxLen < maxScanLen ? maxLen + 1 : maxScanLen;
+        std::size_t strLen  = format_utils::boundedStrLen(str, scanLen);
+        if (strLen<=maxLen)
+        {
+            formatStringBuf( str, strLen, fmtState );
+            return;
         }
+
+        // Строка длиннее maxLength - str[maxLen] гарантированно доступен
+        static const char ellipsisStr[] = "...";
+        std::size_t tailLen = 0;
+        if (fmtState.flags&ellipsis)
+            tailLen = maxLen < 3 ? maxLen : 3;
+
+        std::size_t outLen = format_utils::utf8TruncateLen(str, maxLen - tailLen);
+        formatStringBuf( str, outLen, fmtState, ellipsisStr, tailLen );
+    }
+
+    //-------------------
+    void formatValue( const char* str )
+    {
+        formatStringValue( str, m_formatState );
     }
 
     #if !defined(UMBA_MCU_USED)
     void formatValue( const std::string &s )
     {
-        formatValue( s.c_str() );
+        formatStringValue( s.c_str(), m_formatState, s.size() );
+    }
+    #endif
+
+    #if defined(UMBA_SIMPLE_FORMATTER_STRING_VIEW_SUPPORTED)
+    void formatValue( std::string_view s )
+    {
+        formatStringValue( s.data(), m_formatState, s.size() );
+    }
+    #endif
+
+    //-------------------
+    //! Вывод широкой строки (wchar_t, char16_t, char32_t) с перекодированием в UTF-8 порциями через буфер на стеке
+    /*! ASCII-участки сужаются SIMD-ядром. Если заданы ширина поля или maxLength (в байтах UTF-8),
+        строка сначала измеряется (первый проход), затем перекодируется в вывод (второй проход)
+     */
+    template<typename CharT, typename StateType >
+    void formatWideStringValue( const CharT* str, std::size_t len, const StateType &fmtState )
+    {
+        std::size_t outLen  = len;
+        std::size_t tailLen = 0;
+        int         fillW   = 0;
+
+        if (fmtState.width>0 || fmtState.maxLength>0)
+        {
+            std::size_t maxBytes = fmtState.maxLength>0 ? (std::size_t)fmtState.maxLength : (std::size_t)-1;
+            std::size_t utf8Len  = 0;
+            std::size_t dispW    = 0;
+
+            outLen = format_utils::wideMeasureUtf8(str, len, maxBytes, utf8Len, dispW);
+            if (outLen<len && (fmtState.flags&ellipsis))
+            {
+                tailLen = maxBytes < 3 ? maxBytes : 3;
+                outLen  = format_utils::wideMeasureUtf8(str, len, maxBytes - tailLen, utf8Len, dispW);
+            }
+
+            std::size_t strW = (fmtState.flags&bytewidth) ? utf8Len : dispW;
+            fillW = fmtState.width - (int)(strW + tailLen);
+        }
+
+        FormatFlags align = fmtState.flags & adjustfield;
+
+        if (align!=left)  // right, internal
+             makeFill( fillW, fmtState.fill );
+
+        writeWideBuf( str, outLen );
+        if (tailLen)
+            writeBuf("...", tailLen);
+
+        if (align==left)
+             makeFill( fillW, fmtState.fill );
+    }
+
+    //-------------------
+    //! Широкая строка, завершенная нулем. При заданном maxLength длина ищется не далее maxLength+1 единиц
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value >::type
+    formatValue( const CharT* str )
+    {
+        if (!str)
+        {
+            formatStringValue( (const char*)0, m_formatState );
+            return;
+        }
+
+        std::size_t maxScanLen = m_formatState.maxLength>0 ? (std::size_t)m_formatState.maxLength + 1 : (std::size_t)-1;
+        formatWideStringValue( str, format_utils::wideStrLen(str, maxScanLen), m_formatState );
+    }
+
+    #if !defined(UMBA_MCU_USED)
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value >::type
+    formatValue( const std::basic_string<CharT> &s )
+    {
+        formatWideStringValue( s.data(), s.size(), m_formatState );
+    }
+    #endif
+
+    #if defined(UMBA_SIMPLE_FORMATTER_STRING_VIEW_SUPPORTED)
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value >::type
+    formatValue( std::basic_string_view<CharT> s )
+    {
+        formatWideStringValue( s.data(), s.size(), m_formatState );
+    }
+    #endif
+
+    //-------------------
+    template<typename Spec, typename T >
+    typename std::enable_if< std::is_integral<T>::value
+                          && std::is_unsigned<T>::value
+                           >::type
+    formatValueSpec( T val, const Spec &fmtSpec )
+    {
+        formatUnsignedValue( val, fmtSpec );
+    }
+
+    //-------------------
+    template<typename Spec, typename T >
+    typename std::enable_if< std::is_integral<T>::value
+                          && std::is_signed<T>::value
+                           >::type
+    formatValueSpec( T val, const Spec &fmtSpec )
+    {
+        formatSignedValue( val, fmtSpec );
+    }
+
+    //-------------------
+    template<typename Spec, typename T >
+    typename std::enable_if< std::is_floating_point<T>::value >::type
+    formatValueSpec( T val, const Spec &fmtSpec )
+    {
+        formatFloatValue( val, fmtSpec );
+    }
+
+    //-------------------
+    template<typename Spec >
+    void formatValueSpec( const char* str, const Spec &fmtSpec )
+    {
+        formatStringValue( str, fmtSpec );
+    }
+
+    #if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+
+    //-------------------
+    template<typename Spec >
+    void formatValueSpec( format_utils::uint128_t val, const Spec &fmtSpec )
+    {
+        formatUnsignedValue( val, fmtSpec );
+    }
+
+    //-------------------
+    template<typename Spec >
+    void formatValueSpec( format_utils::int128_t val, const Spec &fmtSpec )
+    {
+        formatSignedValue( val, fmtSpec );
     }
+
     #endif
 
     //-------------------
@@ -1046,6 +2154,8 @@ public:
     SimpleFormatter& operator<<( IntType t )
     {
         SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
         formatValue(t);
         return *this;
     }
@@ -1079,9 +2189,33 @@ public:
     #endif
 
 
+    #if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+
+    SimpleFormatter& operator<<( format_utils::uint128_t t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
+    SimpleFormatter& operator<<( format_utils::int128_t t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
+    #endif
+
     SimpleFormatter& operator<<( const char* t )
     {
         SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
         formatValue(t);
         return *this;
     }
@@ -1089,19 +2223,89 @@ public:
     SimpleFormatter& operator<<( char* t )
     {
         SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
         formatValue((const char*)t);
         return *this;
     }
 
+    //! Широкие строки: const wchar_t*, const char16_t*, const char32_t* (и неконстантные)
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value, SimpleFormatter& >::type
+    operator<<( const CharT* t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
     #if !defined(UMBA_MCU_USED)
     SimpleFormatter& operator<<( const std::string &t )
     {
         SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value, SimpleFormatter& >::type
+    operator<<( const std::basic_string<CharT> &t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
+    template<typename LimbType>
+    SimpleFormatter& operator<<( const format_utils::BigIntView<LimbType> &t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+    #endif
+
+    #if defined(UMBA_SIMPLE_FORMATTER_STRING_VIEW_SUPPORTED)
+    SimpleFormatter& operator<<( std::string_view t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValue(t);
+        return *this;
+    }
+
+    template<typename CharT >
+    typename std::enable_if< format_utils::is_wide_char<CharT>::value, SimpleFormatter& >::type
+    operator<<( std::basic_string_view<CharT> t )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
         formatValue(t);
         return *this;
     }
     #endif
 
+    //-------------------
+    template< typename Spec, typename T >
+    SimpleFormatter& operator<<( const FormatSpecValue<Spec, T> &v )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatValueSpec( v.value, Spec() );
+        return *this;
+    }
+
     //-------------------
     SimpleFormatter& operator<<( omanip::SimpleManip manip )
     {
@@ -1126,15 +2330,52 @@ public:
     //-------------------
     SimpleFormatter& operator<<( omanip::SgrColorManipHelper manipHelper )
     {
+        if (m_disableOutput)
+            return *this;
         return manipHelper.m_manipFn(*this, manipHelper.m_clr);
     }
 
     //-------------------
     SimpleFormatter& operator<<( omanip::ColoringLevelManipHelper manipHelper )
     {
+        if (m_disableOutput)
+            return *this;
         return manipHelper.m_manipFn(*this, manipHelper.m_lvl);
     }
 
+    //-------------------
+    //! Вывод строки с экранированием в стиле C. Ширина и выравнивание не применяются
+    SimpleFormatter& operator<<( const omanip::EscapedStringManipHelper &esc )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        formatEscapedString( esc.m_str, esc.m_len );
+        return *this;
+    }
+
+    //-------------------
+    //! Вывод строкового литерала без копирования (если устройство поддерживает IStableBufWriter). Ширина и выравнивание не применяются
+    SimpleFormatter& operator<<( const omanip::StableStringManipHelper &lit )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        writeStableBuf( lit.m_str, lit.m_len );
+        return *this;
+    }
+
+    //-------------------
+    //! Вывод отложенного значения - функтор вызывается, только если вывод не заблокирован
+    template< typename Callable >
+    SimpleFormatter& operator<<( const omanip::LazyValue<Callable> &v )
+    {
+        SimpleFormatterOutputSentry sentry(*this);
+        if (m_disableOutput)
+            return *this;
+        return *this << v.m_fn();
+    }
+
     bool isTextMode()
     {
         if (!m_charWriter)
@@ -1238,20 +2479,44 @@ public:
     
         virtual void setTermColors(term::colors::SgrColor clr) override
         {
-            m_pFormatter->m_charWriter->setTermColors(clr);
+            m_pFormatter->coloring(clr);
         }
         
-        virtual void terminalMoveToAbs0()                        override { m_pFormatter->m_charWriter->terminalMoveToAbs0()               ; }      
-        virtual void terminalMoveRelative(int direction, int n)  override { m_pFormatter->m_charWriter->terminalMoveRelative(direction, n) ; }
-        virtual void terminalMoveToNextLine(int n)               override { m_pFormatter->m_charWriter->terminalMoveToNextLine(n)          ; }  
-        virtual void terminalMoveToPrevLine(int n)               override { m_pFormatter->m_charWriter->terminalMoveToPrevLine(n)          ; }  
-        virtual void terminalMoveToAbsCol(int n)                 override { m_pFormatter->m_charWriter->terminalMoveToAbsCol(n)            ; }  
-        virtual void terminalMoveToLineStart()                   override { m_pFormatter->m_charWriter->terminalMoveToLineStart()          ; }      
-        virtual void terminalMoveToAbsPos( int x, int y )        override { m_pFormatter->m_charWriter->terminalMoveToAbsPos(x, y)         ; }
-        virtual void terminalClearScreenEnd()                    override { m_pFormatter->m_charWriter->terminalClearScreenEnd()           ; }      
-        virtual void terminalClearScreen()                       override { m_pFormatter->m_charWriter->terminalClearScreen()              ; }      
-        virtual void terminalClearLine()                         override { m_pFormatter->m_charWriter->terminalClearLine()                ; }      
-        virtual void terminalClearLineEnd()                      override { m_pFormatter->m_charWriter->terminalClearLineEnd()             ; }      
+        virtual void terminalMoveToAbs0()                        override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->startLine(); m_pFormatter->m_charWriter->terminalMoveToAbs0(); }
+        virtual void terminalMoveRelative(int direction, int n)  override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalMoveRelative(direction, n) ; }
+        virtual void terminalMoveToNextLine(int n)               override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->startLine(); m_pFormatter->m_charWriter->terminalMoveToNextLine(n); }
+        virtual void terminalMoveToPrevLine(int n)               override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->startLine(); m_pFormatter->m_charWriter->terminalMoveToPrevLine(n); }
+        virtual void terminalMoveToAbsCol(int n)                 override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalMoveToAbsCol(n)            ; }  
+        //! Курсор в начале строки - следующий вывод снова выведет префикс строки. При непустой очереди неблокирующего режима - "\r" через очередь
+        virtual void terminalMoveToLineStart() override
+        {
+            if (m_pFormatter->m_disableOutput)
+                return;
+            m_pFormatter->startLine();
+            if (m_pFormatter->m_nbQueue && m_pFormatter->pumpNonBlock())
+                m_pFormatter->nonBlockWrite((const uint8_t*)"\r", 1);
+            else
+                m_pFormatter->m_charWriter->terminalMoveToLineStart();
+        }
+
+        virtual void terminalMoveToAbsPos( int x, int y )        override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalMoveToAbsPos(x, y)         ; }
+        virtual void terminalClearScreenEnd()                    override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalClearScreenEnd()           ; }      
+        virtual void terminalClearScreen()                       override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalClearScreen()              ; }      
+        virtual void terminalClearLine()                         override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalClearLine()                ; }      
+        //! При непустой очереди неблокирующего режима - ESC [ K через очередь для ANSI-терминалов, для прочих не выполняется
+        virtual void terminalClearLineEnd() override
+        {
+            if (m_pFormatter->m_disableOutput)
+                return;
+            if (m_pFormatter->m_nbQueue && m_pFormatter->pumpNonBlock())
+            {
+                if (m_pFormatter->m_charWriter->isAnsiTerminal())
+                    m_pFormatter->nonBlockWrite((const uint8_t*)"\x1b[K", 3);
+                return;
+            }
+            m_pFormatter->m_charWriter->terminalClearLineEnd();
+        }
+
 
 
         //virtual void terminalMove2Abs0()              override { m_pFormatter->m_charWriter->terminalMove2Abs0();  }
@@ -1263,8 +2528,8 @@ public:
         //virtual void terminalClearLine( int maxPosToClear=-1 ) override { m_pFormatter->m_charWriter->terminalClearLine(maxPosToClear); }
         //virtual void terminalClearRemaining(int maxLines = -1) override { m_pFormatter->m_charWriter->terminalClearRemaining(maxLines); }
 
-        virtual void terminalSetSpinnerMode( bool m ) override { m_pFormatter->m_charWriter->terminalSetSpinnerMode(m); }
-        virtual void terminalSetCaret( int csz ) override { m_pFormatter->m_charWriter->terminalSetCaret( csz ); }
+        virtual void terminalSetSpinnerMode( bool m ) override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalSetSpinnerMode(m); }
+        virtual void terminalSetCaret( int csz ) override { if (m_pFormatter->m_disableOutput) return; m_pFormatter->m_charWriter->terminalSetCaret( csz ); }
 
     
     protected:
@@ -1287,7 +2552,9 @@ public:
 
     void setCharWritter( ICharWriter * pCharWriter )
     {
-        m_charWriter = pCharWriter;
+        m_charWriter    = pCharWriter;
+        m_pStableWriter = 0;
+        invalidateColorCache();
     }
 
 
@@ -1331,20 +2598,94 @@ private:
     }
 
 
+    //! Перекодирует len единиц широкой строки в UTF-8 и выводит порциями через буфер на стеке
+    template<typename CharT >
+    void writeWideBuf( const CharT *str, std::size_t len )
+    {
+        char buf[256];
+
+        while(len)
+        {
+            std::size_t used = 0;
+            std::size_t n    = format_utils::transcodeToUtf8(str, len, &buf[0], sizeof(buf), used);
+            writeBuf(&buf[0], n);
+            str += used;
+            len -= used;
+        }
+    }
+
     void makeFill( int s, char ch)
     {
-        if (s<0)
-           s = 0;
+        if (s<=0)
+           return;
 
-        for(int i=0; i!=s; ++i)
+        // Заполнение выводится блоками, а не по символу - широкие колонки таблиц не дают вызова writeBuf на каждую позицию
+        char fillBuf[16];
+        std::memset(&fillBuf[0], ch, sizeof(fillBuf));
+
+        while(s>0)
         {
-            writeBuf(&ch, 1);
+            int n = s < (int)sizeof(fillBuf) ? s : (int)sizeof(fillBuf);
+            writeBuf(&fillBuf[0], (std::size_t)n);
+            s -= n;
         }
     }
 
     int baseFromFlags(FormatFlags flags) const;
     FormatFlags baseToFlags(int b) const;
 
+    void updateLinePrefixActive();
+    void startLine();
+    void writeLinePrefix();
+    void writeBufPrefixed( const uint8_t *pBuf, size_t sz );
+
+    //! Вывод в устройство - напрямую или через очередь неблокирующего режима
+    void sinkWrite( const uint8_t *pBuf, size_t sz )
+    {
+        if (m_nbQueue)
+            nonBlockWrite(pBuf, sz);
+        else
+            m_charWriter->writeBuf(pBuf, sz);
+    }
+
+    //! Вывод в устройство данных со статическим временем жизни - по ссылке, если задано устройство IStableBufWriter
+    void sinkWriteStable( const uint8_t *pBuf, size_t sz )
+    {
+        if (m_nbQueue)
+            nonBlockWrite(pBuf, sz);
+        else if (m_pStableWriter)
+            m_pStableWriter->writeStableBuf(pBuf, sz);
+        else
+            m_charWriter->writeBuf(pBuf, sz);
+    }
+
+    void nonBlockWrite( const uint8_t *pBuf, size_t sz );
+    size_t nonBlockWriteDirect( const uint8_t *pBuf, size_t sz );
+    size_t nonBlockPump( bool block );
+    void nonBlockQueueColor( umba::term::colors::SgrColor clr );
+    void nonBlockEnqueue( const uint8_t *pBuf, size_t sz );
+    void nonBlockPutEndl();
+
+    //! Изменяет поле состояния форматирования, возвращает предыдущее значение
+    /*! Если состояние сохранено (saveFormatState), то при первом изменении поля его
+        исходное значение запоминается в m_formatStateSaved, и поле помечается в m_stateDirtyMask.
+        Таким образом, сохранение состояния ничего не копирует, а восстановление копирует только измененные поля
+     */
+    template<typename FieldType, typename ValueType>
+    FieldType setStateField( unsigned fieldBit, FieldType FormatState::*pField, ValueType newVal )
+    {
+        FieldType res = m_formatState.*pField;
+        if (m_stateSaved && !(m_stateDirtyMask&fieldBit))
+        {
+            m_formatStateSaved.*pField = res;
+            m_stateDirtyMask |= fieldBit;
+        }
+        m_formatState.*pField = (FieldType)newVal;
+        return res;
+    }
+
+    static void copyStateFields( FormatState &dst, const FormatState &src, unsigned fieldsMask );
+
 
     // disable copying
     SimpleFormatter(const SimpleFormatter &);
@@ -1352,11 +2693,13 @@ private:
 
 
     ICharWriter    *m_charWriter = 0;
+    IStableBufWriter *m_pStableWriter = 0;
 
     CharWriterProxy m_charWriterProxy;
 
     FormatState     m_formatState;
-    FormatState     m_formatStateSaved;
+    FormatState     m_formatStateSaved;      //!< Сохраненные значения только тех полей, которые отмечены в m_stateDirtyMask
+    unsigned        m_stateDirtyMask = 0;    //!< Поля, измененные после saveFormatState
     bool            m_stateSaved = false;
 
 
@@ -1364,6 +2707,48 @@ private:
     disable_stack_type  m_disableStack;
     bool                m_disableOutput;
 
+    ColoringLevel       m_logLevel = ColoringLevel::debug;
+
+    FlushPolicy         m_flushPolicy        = FlushPolicy::perLine;
+    uint32_t            m_flushParam         = 0;
+    FlushTickSource     m_flushTickSource    = 0;
+    uint32_t            m_lastFlushTick      = 0;
+    size_t              m_unflushedBytes     = 0;
+    ColoringLevel       m_flushLevel         = ColoringLevel::error;
+    ColoringLevel       m_msgLevel           = ColoringLevel::normal;  //!< Наиболее важный уровень в текущей строке, normal - уровень не задавался
+    ColoringLevel       m_doneLinesLevel     = ColoringLevel::normal;  //!< Наиболее важный уровень строк, завершенных после последнего сброса
+
+    ILinePrefixProvider *m_pLinePrefixProvider = 0;
+    const char         *m_linePrefix          = 0;
+    size_t              m_linePrefixLen       = 0;
+    formatter_utils::SimpleIndentStack m_indentStack;
+    bool                m_linePrefixActive    = false;  //!< Задан префикс или отступ - writeBuf разбивает вывод по строкам
+    bool                m_atLineStart         = true;
+
+    uint8_t            *m_nbQueue             = 0;      //!< Кольцевая очередь неблокирующего режима, 0 - режим выключен
+    size_t              m_nbSize              = 0;
+    size_t              m_nbHead              = 0;      //!< Начало данных в очереди
+    size_t              m_nbCount             = 0;      //!< Количество байт в очереди
+    NonBlockOverflowPolicy m_nbPolicy         = NonBlockOverflowPolicy::drop;
+    NonBlockStats       m_nbStats;
+    size_t              m_nbInTotal           = 0;      //!< Всего помещено в очередь байт (позиции отложенных смен цвета)
+    size_t              m_nbOutTotal          = 0;      //!< Всего выведено из очереди байт
+    bool                m_nbFlushPending      = false;  //!< Сброс устройства отложен до опустошения очереди
+
+    //! Смена цвета, отложенная до вывода данных, стоявших в очереди перед ней
+    struct NonBlockPendingColor
+    {
+        size_t                          pos;  //!< значение m_nbInTotal на момент запроса
+        umba::term::colors::SgrColor    clr;
+    };
+
+    NonBlockPendingColor m_nbColors[nonBlockMaxPendingColors];
+    unsigned            m_nbNumColors         = 0;
+
+    umba::term::colors::SgrColor m_curColor = 0;     //!< Последний установленный цвет терминала
+    bool                m_curColorValid   = false;   //!< m_curColor действителен
+    int                 m_colorsSupported = -1;      //!< Поддержка цвета устройством вывода: -1 - еще не проверялась, 0 - нет, 1 - да
+
 
     
     umba::term::colors::SgrColor m_coloringLevelColors[ (unsigned)ColoringLevel::num_levels ] = // fgColor, bgColor, fBright, fInvert, fBlink
@@ -1387,6 +2772,18 @@ private:
 
 
 
+//-----------------------------------------------------------------------------
+//! Вывод значения со спецификацией формата, заданной во время компиляции
+/*! Пример: fmt << umba::spec< SimpleFormatter::hex|SimpleFormatter::fmtauto, 8 >(x);
+    Текущее состояние форматирования SimpleFormatter не используется и не изменяется
+ */
+template< SimpleFormatter::FormatFlags Flags, int Width = 0, char Fill = ' ', int Precision = 3, typename T >
+SimpleFormatter::FormatSpecValue< SimpleFormatter::FormatSpec<Flags, Width, Fill, Precision>, T > spec( T val )
+{
+    SimpleFormatter::FormatSpecValue< SimpleFormatter::FormatSpec<Flags, Width, Fill, Precision>, T > v = { val };
+    return v;
+}
+
 //-----------------------------------------------------------------------------
 inline
 SimpleFormatterManipSentry::SimpleFormatterManipSentry( SimpleFormatter &simpleFormatter )
@@ -1409,6 +2806,21 @@ SimpleFormatterOutputSentry::~SimpleFormatterOutputSentry()
     }
 
 //-----------------------------------------------------------------------------
+inline
+SimpleFormatterIndentSentry::SimpleFormatterIndentSentry( SimpleFormatter &simpleFormatter, int n )
+    : m_simpleFormatter(simpleFormatter)
+{
+    m_simpleFormatter.pushIndent(n);
+}
+
+//-----------------------------------------------------------------------------
+inline
+SimpleFormatterIndentSentry::~SimpleFormatterIndentSentry()
+{
+    m_simpleFormatter.popIndent();
+}
+
+//-----------------------------------------------------------------------------
 
 
 
@@ -1427,6 +2839,8 @@ inline
 SimpleFormatter& flush( SimpleFormatter& fmt )
 {
     SimpleFormatterOutputSentry sentry(fmt);
+    if (!fmt.isOutputEnabled())
+        return fmt;
     fmt.flush();
     return fmt;
 }
@@ -1436,6 +2850,8 @@ inline
 SimpleFormatter& wflush( SimpleFormatter& fmt )
 {
     SimpleFormatterOutputSentry sentry(fmt);
+    if (!fmt.isOutputEnabled())
+        return fmt;
     fmt.waitFlushDone();
     return fmt;
 }
@@ -1445,6 +2861,8 @@ inline
 SimpleFormatter& endl( SimpleFormatter& fmt )
 {
     SimpleFormatterOutputSentry sentry(fmt);
+    if (!fmt.isOutputEnabled())
+        return fmt;
 /*
     if (fmt.isTextMode())
     {
@@ -1464,7 +2882,7 @@ SimpleFormatter& endl( SimpleFormatter& fmt )
 */
     fmt.coloring( ColoringLevel::normal );
     fmt.putEndl();
-    fmt.flush();
+    fmt.requestFlush();
     return fmt;
 }
 
@@ -1473,9 +2891,11 @@ inline
 SimpleFormatter& cret( SimpleFormatter& fmt )
 {
     SimpleFormatterOutputSentry sentry(fmt);
+    if (!fmt.isOutputEnabled())
+        return fmt;
     fmt.coloring( ColoringLevel::normal );
     fmt.putCR();
-    fmt.flush();
+    fmt.requestFlush();
     return fmt;
 }
 
@@ -1484,9 +2904,11 @@ inline
 SimpleFormatter& feed( SimpleFormatter& fmt )
 {
     SimpleFormatterOutputSentry sentry(fmt);
+    if (!fmt.isOutputEnabled())
+        return fmt;
     fmt.coloring( ColoringLevel::normal );
     fmt.putFF();
-    fmt.flush();
+    fmt.requestFlush();
     return fmt;
 }
 
@@ -1521,6 +2943,8 @@ UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( showpos    , showpos )
 UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( uppercase  , uppercase )
 UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( uppercasebase , uppercasebase )
 UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( fmtauto    , fmtauto )
+UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( ellipsis   , ellipsis )
+UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS( bytewidth  , bytewidth )
 //UMBA_SIMPLE_FORMATTER_IMPLEMENT_SET_UNSET_FLAG_MANIPS(    ,  )
 
 
@@ -1771,6 +3195,54 @@ SimpleFormatter& persistent( SimpleFormatter& fmt )
     return fmt;
 }
 
+//-----------------------------------------------------------------------------
+//! Вывод строки с экранированием непечатных символов в стиле C: fmt << omanip::escaped(payload);
+inline
+EscapedStringManipHelper escaped( const char *str, std::size_t len )
+{
+    EscapedStringManipHelper h = { str, str ? len : 0 };
+    return h;
+}
+
+inline
+EscapedStringManipHelper escaped( const char *str )
+{
+    return escaped( str, str ? std::strlen(str) : 0 );
+}
+
+#if !defined(UMBA_MCU_USED)
+inline
+EscapedStringManipHelper escaped( const std::string &str )
+{
+    return escaped( str.data(), str.size() );
+}
+#endif
+
+//-----------------------------------------------------------------------------
+//! Строковый литерал, передаваемый устройству вывода по ссылке, без копирования: fmt << omanip::literal("rx: ") << n;
+/*! Принимает только массивы - строка должна иметь статическое время жизни (литерал, статический массив),
+    не используйте с локальными буферами
+ */
+template<std::size_t N>
+StableStringManipHelper literal( const char (&str)[N] )
+{
+    StableStringManipHelper h = { &str[0], N ? N-1 : 0 };
+    return h;
+}
+
+//-----------------------------------------------------------------------------
+//! Отложенное вычисление выводимого значения
+/*! Функтор (без аргументов, возвращает выводимое значение) вызывается только
+    если вывод не заблокирован, например:
+    fmt << "state: " << omanip::lazy( [&]() { return dumpState(obj); } ) << endl;
+ */
+template<typename Callable>
+LazyValue< typename std::decay<Callable>::type > lazy( Callable &&fn )
+{
+    LazyValue< typename std::decay<Callable>::type > v = { std::forward<Callable>(fn) };
+    return v;
+}
+
 //-----------------------------------------------------------------------------
 #define UMBA_SIMPLE_FORMATTER_BEGIN_IMPLEMENT_INT_MANIP( manipName ) \
     inline                                                           \
@@ -1920,6 +3392,13 @@ UMBA_SIMPLE_FORMATTER_BEGIN_IMPLEMENT_INT_MANIP(decpoint)
 }
 UMBA_SIMPLE_FORMATTER_END_IMPLEMENT_INT_MANIP(decpoint)
 
+UMBA_SIMPLE_FORMATTER_BEGIN_IMPLEMENT_INT_MANIP(maxlength)
+{
+    fmt.maxlength( i );
+    return fmt;
+}
+UMBA_SIMPLE_FORMATTER_END_IMPLEMENT_INT_MANIP(maxlength)
+
 
 
 
@@ -2143,6 +3622,31 @@ static const int caretMax       = 3;
 } // namespace umba
 
 
+
+//-----------------------------------------------------------------------------
+//! Вывод сообщения уровня lvl (имя элемента ColoringLevel) с фильтрацией по уровню
+/*! Пример: UMBA_LOG(umba::lout, debug) << "x: " << x << umba::omanip::endl;
+
+    Если уровень ниже UMBA_LOG_MIN_LEVEL, условие - константа времени компиляции, и вся цепочка
+    вывода вместе с аргументами удаляется компилятором. Иначе перед форматированием проверяется
+    уровень времени выполнения (SimpleFormatter::logLevel()), и сообщение раскрашивается цветом уровня.
+    Конструкция if/else позволяет безопасно использовать макрос в if без фигурных скобок
+ */
+#define UMBA_LOG( fmt, lvl )                                                                              \
+    if ( !umba::log_utils::isLevelCompiled(umba::ColoringLevel::lvl)                                      \
+      || !(fmt).isLogLevelEnabled(umba::ColoringLevel::lvl) ) {}                                         \
+    else (fmt) << umba::omanip::coloring(umba::ColoringLevel::lvl)
+
+#define UMBA_LOG_EMERGENCY( fmt )    UMBA_LOG( fmt, emergency )
+#define UMBA_LOG_ALERT( fmt )        UMBA_LOG( fmt, alert     )
+#define UMBA_LOG_CRITICAL( fmt )     UMBA_LOG( fmt, critical  )
+#define UMBA_LOG_ERROR( fmt )        UMBA_LOG( fmt, error     )
+#define UMBA_LOG_WARNING( fmt )      UMBA_LOG( fmt, warning   )
+#define UMBA_LOG_NOTICE( fmt )       UMBA_LOG( fmt, notice    )
+#define UMBA_LOG_INFO( fmt )         UMBA_LOG( fmt, info      )
+#define UMBA_LOG_DEBUG( fmt )        UMBA_LOG( fmt, debug     )
+
+
 //NOTE: !!! Add here support for std::iomanip's
 #if !defined(UMBA_MCU_USED)
 
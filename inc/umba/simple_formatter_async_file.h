@@ -0,0 +1,279 @@
+/*! \file
+\brief Устройство вывода в файл с несколькими буферами и асинхронной записью в отдельном потоке (только POSIX)
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED) && (defined(__unix__) || defined(__APPLE__))
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Устройство вывода в файл с асинхронной записью заполненных буферов
+/*! Вывод форматтера копируется в текущий буфер. Заполненный буфер (или частично заполненный - при flush())
+    передается потоку записи, а форматтер сразу продолжает заполнять следующий свободный буфер.
+    Форматтер ожидает только если все буферы находятся в записи (диск не успевает).
+
+    waitFlushDone() ожидает завершения записи всех переданных буферов.
+
+    flush() не блокирует, но каждый вызов передает потоку записи отдельный буфер - при сбросе на каждом
+    omanip::endl буферы будут почти пустыми. Для этого устройства лучше использовать политику сброса
+    FlushPolicy::perBytes или perInterval.
+
+    Запись выполняется в потоке методом writeBlock. Другой механизм асинхронной записи (например, io_uring)
+    может быть подключен в наследнике переопределением writeBlock.
+
+    Ошибки записи (кроме EINTR) не прерывают работу: данные буфера отбрасываются,
+    код ошибки доступен через getLastError()
+ */
+class AsyncFileCharWriter : public ICharWriter
+{
+
+public:
+
+    static const std::size_t defaultBufferSize = 64u*1024u;
+    static const unsigned    defaultNumBuffers = 4;
+
+    //! closeOnDestroy - закрыть дескриптор в деструкторе. numBuffers - не менее двух
+    explicit AsyncFileCharWriter( int fd, bool closeOnDestroy = false, std::size_t bufferSize = defaultBufferSize, unsigned numBuffers = defaultNumBuffers )
+    {
+        init(fd, closeOnDestroy, bufferSize, numBuffers);
+    }
+
+    //! Создает (или перезаписывает) файл
+    explicit AsyncFileCharWriter( const char *fileName, std::size_t bufferSize = defaultBufferSize, unsigned numBuffers = defaultNumBuffers )
+    {
+        int fd = ::open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd<0)
+            m_lastError = errno;
+        init(fd, true, bufferSize, numBuffers);
+    }
+
+    //! Выводит накопленное, дожидается окончания записи и останавливает поток записи
+    virtual ~AsyncFileCharWriter()
+    {
+        stopWriter();
+
+        if (m_closeOnDestroy && m_fd>=0)
+            ::close(m_fd);
+    }
+
+    bool isOpen() const
+    {
+        return m_fd>=0;
+    }
+
+    //! errno последней ошибки (0 - ошибок не было)
+    int getLastError() const
+    {
+        return m_lastError.load();
+    }
+
+    //-------------------
+    virtual void writeChar( char ch ) override
+    {
+        if (m_curLen==m_bufferSize)
+            submitCurrent();
+        m_pCur[m_curLen++] = (uint8_t)ch;
+    }
+
+    virtual void writeBuf( const uint8_t* pBuf, size_t len ) override
+    {
+        while(len)
+        {
+            if (m_curLen==m_bufferSize)
+                submitCurrent();
+
+            std::size_t avail = m_bufferSize - m_curLen;
+            std::size_t chunk = len<avail ? len : avail;
+
+            std::memcpy(m_pCur + m_curLen, pBuf, chunk);
+            m_curLen += chunk;
+            pBuf     += chunk;
+            len      -= chunk;
+        }
+    }
+
+    //! Передает текущий буфер потоку записи, не дожидаясь записи
+    virtual void flush() override
+    {
+        if (m_curLen)
+            submitCurrent();
+    }
+
+    //! Ожидает окончания записи всех переданных буферов
+    virtual void waitFlushDone() override
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvFree.wait(lock, [this]() { return m_pending.empty() && !m_writing; });
+    }
+
+
+protected:
+
+    struct PendingBuffer
+    {
+        unsigned        idx;
+        std::size_t     len;
+    };
+
+    //-------------------
+    void init( int fd, bool closeOnDestroy, std::size_t bufferSize, unsigned numBuffers )
+    {
+        m_fd             = fd;
+        m_closeOnDestroy = closeOnDestroy;
+        m_bufferSize     = bufferSize ? bufferSize : defaultBufferSize;
+        m_numBuffers     = numBuffers<2 ? 2 : numBuffers;
+
+        m_storage.resize(m_bufferSize*m_numBuffers);
+        for(unsigned i=1; i!=m_numBuffers; ++i)
+            m_free.push_back(i);
+
+        m_curIdx = 0;
+        m_pCur   = bufferPtr(m_curIdx);
+
+        m_thread = std::thread(&AsyncFileCharWriter::writerThreadProc, this);
+    }
+
+    uint8_t* bufferPtr( unsigned idx )
+    {
+        return &m_storage[(std::size_t)idx*m_bufferSize];
+    }
+
+    //! Передача текущего буфера потоку записи и переход к свободному буферу (с ожиданием, если свободных нет)
+    void submitCurrent()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        PendingBuffer pb = { m_curIdx, m_curLen };
+        m_pending.push_back(pb);
+        m_cvPending.notify_one();
+
+        m_cvFree.wait(lock, [this]() { return !m_free.empty(); });
+        m_curIdx = m_free.back();
+        m_free.pop_back();
+
+        m_pCur   = bufferPtr(m_curIdx);
+        m_curLen = 0;
+    }
+
+    //! Вывод накопленного и остановка потока записи. Наследник, переопределяющий writeBlock, должен вызвать его в своем деструкторе
+    void stopWriter()
+    {
+        if (!m_thread.joinable())
+            return;
+
+        flush();
+        waitFlushDone();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cvPending.notify_one();
+
+        m_thread.join();
+    }
+
+    //-------------------
+    //! Запись блока в файл (вызывается из потока записи). Возвращает false при ошибке
+    virtual bool writeBlock( const uint8_t *pBuf, std::size_t len )
+    {
+        while(len)
+        {
+            ssize_t res = ::write(m_fd, pBuf, len);
+            if (res<0)
+            {
+                if (errno==EINTR)
+                    continue;
+                m_lastError = errno;
+                return false;
+            }
+
+            pBuf += (std::size_t)res;
+            len  -= (std::size_t)res;
+        }
+
+        return true;
+    }
+
+    void writerThreadProc()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for(;;)
+        {
+            m_cvPending.wait(lock, [this]() { return m_stop || !m_pending.empty(); });
+            if (m_pending.empty())
+                return; // m_stop
+
+            PendingBuffer pb = m_pending.front();
+            m_pending.pop_front();
+            m_writing = true;
+
+            lock.unlock();
+            if (m_fd>=0)
+                writeBlock(bufferPtr(pb.idx), pb.len);
+            lock.lock();
+
+            m_writing = false;
+            m_free.push_back(pb.idx);
+            m_cvFree.notify_all();
+        }
+    }
+
+
+    // disable copying
+    AsyncFileCharWriter(const AsyncFileCharWriter&);
+    AsyncFileCharWriter& operator=(const AsyncFileCharWriter&);
+
+
+    int                         m_fd             = -1;
+    bool                        m_closeOnDestroy = false;
+    std::atomic<int>            m_lastError{0};
+
+    std::size_t                 m_bufferSize     = defaultBufferSize;
+    unsigned                    m_numBuffers     = defaultNumBuffers;
+    std::vector<uint8_t>        m_storage;
+
+    // Заполняемый буфер - только поток форматтера
+    unsigned                    m_curIdx         = 0;
+    uint8_t                    *m_pCur           = 0;
+    std::size_t                 m_curLen         = 0;
+
+    // Под m_mutex
+    std::mutex                  m_mutex;
+    std::condition_variable     m_cvPending;     //!< появился буфер для записи / остановка
+    std::condition_variable     m_cvFree;        //!< буфер записан
+    std::deque<PendingBuffer>   m_pending;
+    std::vector<unsigned>       m_free;
+    bool                        m_writing        = false;
+    bool                        m_stop           = false;
+
+    std::thread                 m_thread;
+
+}; // class AsyncFileCharWriter
+
+
+} // namespace umba
+
+#endif // !UMBA_MCU_USED && POSIX
+
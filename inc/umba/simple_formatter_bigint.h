@@ -0,0 +1,663 @@
+/*! \file
+\brief Преобразование целых чисел произвольной разрядности (массивов лимбов) в строку цифр для SimpleFormatter
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+namespace umba
+{
+
+namespace format_utils
+{
+
+//-----------------------------------------------------------------------------
+//! Невладеющее представление целого числа произвольной разрядности - модуль в виде массива лимбов и знак
+/*! Лимбы располагаются от младших к старшим. LimbType - беззнаковый целый тип (обычно uint32_t или uint64_t)
+ */
+template<typename LimbType>
+struct BigIntView
+{
+    const LimbType  *limbs;
+    std::size_t      count;
+    bool             negative;
+
+}; // struct BigIntView
+
+
+namespace bigint_impl
+{
+
+typedef std::vector<uint32_t> Limbs;
+
+//! Лимбы в 10^9 - максимальная степень 10, помещающаяся в 32х-битный лимб
+static const uint32_t decChunkDivisor = 1000000000u;
+static const int      decChunkDigits  = 9;
+
+//! Размер числа (в 32х-битных лимбах), начиная с которого десятичное преобразование делит число пополам
+static const std::size_t decSplitThreshold = 8;
+
+//! Размер меньшего сомножителя (в лимбах), начиная с которого умножение выполняется методом Карацубы
+static const std::size_t karatsubaThreshold = 32;
+
+//! Размер делителя (в лимбах), начиная с которого деление выполняется умножением на обратную величину (Барретт),
+//! а обратная величина вычисляется итерацией Ньютона
+static const std::size_t barrettThreshold = 256;
+
+//-----------------------------------------------------------------------------
+inline
+void normalize( Limbs &x )
+{
+    while(!x.empty() && x.back()==0)
+        x.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+template<typename LimbType>
+Limbs toLimbs32( const LimbType *pLimbs, std::size_t count )
+{
+    static_assert( std::is_unsigned<LimbType>::value, "BigIntView limb type must be unsigned" );
+
+    const unsigned limbBits  = (unsigned)(sizeof(LimbType)*CHAR_BIT);
+    const unsigned partBits  = limbBits<32 ? limbBits : 32;
+    const uint32_t partMask  = partBits<32 ? (uint32_t)((1u<<partBits) - 1u) : 0xFFFFFFFFu;
+
+    Limbs res;
+    res.reserve( (count*limbBits + 31)/32 );
+
+    uint64_t acc     = 0;
+    unsigned accBits = 0;
+
+    for(std::size_t i=0; i!=count; ++i)
+    {
+        for(unsigned b=0; b<limbBits; b+=partBits)
+        {
+            acc     |= (uint64_t)((uint32_t)(pLimbs[i]>>b) & partMask) << accBits;
+            accBits += partBits;
+            if (accBits>=32)
+            {
+                res.push_back((uint32_t)acc);
+                acc    >>= 32;
+                accBits -= 32;
+            }
+        }
+    }
+
+    if (accBits)
+        res.push_back((uint32_t)acc);
+
+    normalize(res);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+inline
+int compare( const Limbs &a, const Limbs &b )
+{
+    if (a.size()!=b.size())
+        return a.size()<b.size() ? -1 : 1;
+
+    for(std::size_t i=a.size(); i--; )
+    {
+        if (a[i]!=b[i])
+            return a[i]<b[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+//! Деление на однолимбовое число на месте, возвращает остаток
+inline
+uint32_t divSmall( Limbs &x, uint32_t d )
+{
+    uint64_t rem = 0;
+    for(std::size_t i=x.size(); i--; )
+    {
+        uint64_t cur = (rem<<32) | x[i];
+        x[i] = (uint32_t)(cur / d);
+        rem  = cur % d;
+    }
+
+    normalize(x);
+    return (uint32_t)rem;
+}
+
+//-----------------------------------------------------------------------------
+//! Лимбы [from, to) числа x (to ограничивается размером x)
+inline
+Limbs slice( const Limbs &x, std::size_t from, std::size_t to )
+{
+    if (to>x.size())
+        to = x.size();
+    if (from>=to)
+        return Limbs();
+
+    Limbs res(x.begin()+(std::ptrdiff_t)from, x.begin()+(std::ptrdiff_t)to);
+    normalize(res);
+    return res;
+}
+
+//! x * B^k
+inline
+Limbs shiftLeftLimbs( const Limbs &x, std::size_t k )
+{
+    if (x.empty())
+        return x;
+
+    Limbs res(k, 0);
+    res.insert(res.end(), x.begin(), x.end());
+    return res;
+}
+
+//! floor(x / B^k)
+inline
+Limbs shiftRightLimbs( const Limbs &x, std::size_t k )
+{
+    return slice(x, k, x.size());
+}
+
+//-----------------------------------------------------------------------------
+//! acc += x * B^shift
+inline
+void addShifted( Limbs &acc, const Limbs &x, std::size_t shift )
+{
+    if (x.empty())
+        return;
+
+    std::size_t size = acc.size()>shift+x.size() ? acc.size() : shift+x.size();
+    acc.resize(size+1, 0);
+
+    uint64_t carry = 0;
+    std::size_t i = 0;
+    for(; i!=x.size(); ++i)
+    {
+        uint64_t sum = (uint64_t)acc[shift+i] + x[i] + carry;
+        acc[shift+i] = (uint32_t)sum;
+        carry = sum>>32;
+    }
+
+    for(i+=shift; carry; ++i)
+    {
+        uint64_t sum = (uint64_t)acc[i] + carry;
+        acc[i] = (uint32_t)sum;
+        carry = sum>>32;
+    }
+
+    normalize(acc);
+}
+
+inline
+Limbs add( const Limbs &a, const Limbs &b )
+{
+    Limbs res = a;
+    addShifted(res, b, 0);
+    return res;
+}
+
+//! a -= b, a >= b
+inline
+void subInPlace( Limbs &a, const Limbs &b )
+{
+    int64_t borrow = 0;
+    std::size_t i = 0;
+    for(; i!=b.size(); ++i)
+    {
+        int64_t t = (int64_t)a[i] - b[i] - borrow;
+        a[i]   = (uint32_t)t;
+        borrow = t<0 ? 1 : 0;
+    }
+
+    for(; borrow; ++i)
+    {
+        int64_t t = (int64_t)a[i] - borrow;
+        a[i]   = (uint32_t)t;
+        borrow = t<0 ? 1 : 0;
+    }
+
+    normalize(a);
+}
+
+//! a - b, a >= b
+inline
+Limbs sub( const Limbs &a, const Limbs &b )
+{
+    Limbs res = a;
+    subInPlace(res, b);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+inline
+Limbs mulSchool( const Limbs &a, const Limbs &b )
+{
+    if (a.empty() || b.empty())
+        return Limbs();
+
+    Limbs res(a.size()+b.size(), 0);
+
+    for(std::size_t i=0; i!=a.size(); ++i)
+    {
+        uint64_t carry = 0;
+        for(std::size_t j=0; j!=b.size(); ++j)
+        {
+            uint64_t cur = (uint64_t)a[i]*b[j] + res[i+j] + carry;
+            res[i+j] = (uint32_t)cur;
+            carry    = cur>>32;
+        }
+        res[i+b.size()] = (uint32_t)carry;
+    }
+
+    normalize(res);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+//! Умножение: школьное для малых сомножителей, иначе Карацуба - O(n^1.585)
+inline
+Limbs mul( const Limbs &a, const Limbs &b )
+{
+    if (a.size()<b.size())
+        return mul(b, a);
+
+    if (b.size()<karatsubaThreshold)
+        return mulSchool(a, b);
+
+    // Сильно различающиеся размеры - большой сомножитель умножаем частями размера меньшего
+    if (a.size()>=2*b.size())
+    {
+        Limbs res;
+        for(std::size_t off=0; off<a.size(); off+=b.size())
+            addShifted(res, mul(slice(a, off, off+b.size()), b), off);
+        return res;
+    }
+
+    // a = a1*B^m + a0, b = b1*B^m + b0
+    // a*b = z2*B^2m + ((a0+a1)*(b0+b1) - z0 - z2)*B^m + z0
+    std::size_t m = a.size()/2;
+
+    Limbs a0 = slice(a, 0, m), a1 = slice(a, m, a.size());
+    Limbs b0 = slice(b, 0, m), b1 = slice(b, m, b.size());
+
+    Limbs z0 = mul(a0, b0);
+    Limbs z2 = mul(a1, b1);
+    Limbs z1 = mul(add(a0, a1), add(b0, b1));
+    subInPlace(z1, z0);
+    subInPlace(z1, z2);
+
+    Limbs res = z0;
+    addShifted(res, z1, m);
+    addShifted(res, z2, 2*m);
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+inline
+int countLeadingZeros( uint32_t v )
+{
+    int n = 0;
+    while(!(v & 0x80000000u))
+    {
+        v <<= 1;
+        ++n;
+    }
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+//! Деление с остатком (Кнут, алгоритм D) - O(размер делителя * размер частного)
+inline
+void divMod( const Limbs &u, const Limbs &v, Limbs &q, Limbs &r )
+{
+    if (compare(u, v)<0)
+    {
+        q.clear();
+        r = u;
+        return;
+    }
+
+    if (v.size()==1)
+    {
+        q = u;
+        r.assign(1, divSmall(q, v[0]));
+        normalize(r);
+        return;
+    }
+
+    const std::size_t n = v.size();
+    const std::size_t m = u.size() - n;
+    const int         s = countLeadingZeros(v.back());
+
+    // Нормализация - старший бит делителя должен быть установлен
+    Limbs vn(n), un(u.size()+1);
+    for(std::size_t i=n-1; i>0; --i)
+        vn[i] = s ? (v[i]<<s) | (v[i-1]>>(32-s)) : v[i];
+    vn[0] = v[0]<<s;
+
+    un[u.size()] = s ? u.back()>>(32-s) : 0;
+    for(std::size_t i=u.size()-1; i>0; --i)
+        un[i] = s ? (u[i]<<s) | (u[i-1]>>(32-s)) : u[i];
+    un[0] = u[0]<<s;
+
+    q.assign(m+1, 0);
+
+    const uint64_t b = 0x100000000ull;
+
+    for(std::size_t j=m+1; j--; )
+    {
+        uint64_t num  = ((uint64_t)un[j+n]<<32) | un[j+n-1];
+        uint64_t qhat = num / vn[n-1];
+        uint64_t rhat = num - qhat*vn[n-1];
+
+        while(qhat>=b || qhat*vn[n-2] > ((rhat<<32) | un[j+n-2]))
+        {
+            --qhat;
+            rhat += vn[n-1];
+            if (rhat>=b)
+                break;
+        }
+
+        int64_t k = 0;
+        int64_t t = 0;
+        for(std::size_t i=0; i!=n; ++i)
+        {
+            uint64_t p = qhat*vn[i];
+            t = (int64_t)un[i+j] - k - (int64_t)(p & 0xFFFFFFFFu);
+            un[i+j] = (uint32_t)t;
+            k = (int64_t)(p>>32) - (t>>32);
+        }
+        t = (int64_t)un[j+n] - k;
+        un[j+n] = (uint32_t)t;
+
+        q[j] = (uint32_t)qhat;
+
+        if (t<0)
+        {
+            // qhat оказалась на единицу больше - добавляем делитель обратно
+            q[j] -= 1;
+            uint64_t c = 0;
+            for(std::size_t i=0; i!=n; ++i)
+            {
+                uint64_t sum = (uint64_t)un[i+j] + vn[i] + c;
+                un[i+j] = (uint32_t)sum;
+                c = sum>>32;
+            }
+            un[j+n] = (uint32_t)((uint64_t)un[j+n] + c);
+        }
+    }
+
+    r.resize(n);
+    for(std::size_t i=0; i!=n; ++i)
+        r[i] = s ? (un[i]>>s) | (un[i+1]<<(32-s)) : un[i];
+
+    normalize(q);
+    normalize(r);
+}
+
+//-----------------------------------------------------------------------------
+//! B^(2n), n - количество лимбов
+inline
+Limbs powB2n( std::size_t n )
+{
+    Limbs res(2*n+1, 0);
+    res[2*n] = 1;
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+//! Обратная величина делителя для деления по Барретту: floor(B^(2n) / d), n = d.size()
+/*! Итерация Ньютона с удвоением точности: по обратной величине старшей половины делителя (рекурсивно)
+    один шаг x1 = x0 + x0*(B^(2n) - d*x0)/B^(2n) дает погрешность в несколько лимбов, которая
+    устраняется точно делением остатка (частное - несколько лимбов, O(n)). Стоимость - O(M(n))
+ */
+inline
+Limbs reciprocal( const Limbs &d )
+{
+    const std::size_t n = d.size();
+    const Limbs       p = powB2n(n);
+
+    Limbs q, r;
+
+    if (n<barrettThreshold)
+    {
+        divMod(p, d, q, r);
+        return q;
+    }
+
+    const std::size_t h = (n+1)/2;
+    const std::size_t k = n - h;
+
+    // B^(2n)/d ~ (B^(2h)/dh) * B^k, dh - старшие h лимбов d
+    Limbs x = shiftLeftLimbs(reciprocal(slice(d, k, n)), k);
+
+    // Шаг Ньютона
+    Limbs dx = mul(d, x);
+    if (compare(dx, p)<=0)
+    {
+        x = add(x, shiftRightLimbs(mul(x, sub(p, dx)), 2*n));
+    }
+    else
+    {
+        Limbs corr = shiftRightLimbs(mul(x, sub(dx, p)), 2*n);
+        if (compare(corr, x)<0)
+            subInPlace(x, corr);
+    }
+
+    // Точная коррекция
+    dx = mul(d, x);
+    if (compare(dx, p)<=0)
+    {
+        divMod(sub(p, dx), d, q, r);
+        x = add(x, q);
+    }
+    else
+    {
+        divMod(sub(dx, p), d, q, r);
+        if (!r.empty())
+            q = add(q, Limbs(1, 1u));
+        subInPlace(x, q);
+    }
+
+    return x;
+}
+
+//-----------------------------------------------------------------------------
+//! Деление по Барретту: x < B^(2n), n = d.size(), mu = reciprocal(d). Два умножения и не более двух вычитаний
+inline
+void divModBarrett( const Limbs &x, const Limbs &d, const Limbs &mu, Limbs &q, Limbs &r )
+{
+    const std::size_t n = d.size();
+
+    q = shiftRightLimbs(mul(shiftRightLimbs(x, n-1), mu), n+1);
+    r = sub(x, mul(q, d));
+
+    while(compare(r, d)>=0)
+    {
+        subInPlace(r, d);
+        q = add(q, Limbs(1, 1u));
+    }
+}
+
+//-----------------------------------------------------------------------------
+//! Простое преобразование - последовательное деление на 10^9. padDigits - дополнить ведущими нулями до указанного количества цифр
+inline
+void toDecimalSimple( Limbs x, std::size_t padDigits, std::string &out )
+{
+    uint32_t chunks[ decSplitThreshold*2 + 2 ]; // x < (2^32)^(2*threshold) < 10^(9*(2*threshold+1))
+    std::size_t numChunks = 0;
+
+    while(!x.empty())
+        chunks[numChunks++] = divSmall(x, decChunkDivisor);
+
+    char buf[decChunkDigits*(decSplitThreshold*2 + 2)];
+    char *pEnd = &buf[0] + sizeof(buf);
+    char *p    = pEnd;
+
+    for(std::size_t i=0; i!=numChunks; ++i)
+    {
+        uint32_t c = chunks[i];
+        for(int d=0; d!=decChunkDigits; ++d)
+        {
+            *--p = (char)('0' + c%10u);
+            c /= 10u;
+        }
+    }
+
+    while(p!=pEnd && *p=='0')
+        ++p;
+
+    std::size_t len = (std::size_t)(pEnd-p);
+    if (len<padDigits)
+        out.append(padDigits-len, '0');
+    out.append(p, len);
+}
+
+//-----------------------------------------------------------------------------
+//! Рекурсивное преобразование "разделяй и властвуй": x = q*10^(9*2^k) + r, q и r преобразуются независимо
+/*! x < pows[k]^2. Для больших степеней деление выполняется по Барретту с обратными величинами invs[k],
+    поэтому преобразование стоит O(M(n) log n) при умножении Карацубы
+ */
+inline
+void toDecimalRecursive( const Limbs &x, const std::vector<Limbs> &pows, const std::vector<Limbs> &invs, int k, std::size_t padDigits, std::string &out )
+{
+    if (k<0 || x.size()<=decSplitThreshold)
+    {
+        toDecimalSimple(x, padDigits, out);
+        return;
+    }
+
+    const Limbs &d = pows[(std::size_t)k];
+
+    if (compare(x, d)<0)
+    {
+        toDecimalRecursive(x, pows, invs, k-1, padDigits, out);
+        return;
+    }
+
+    Limbs q, r;
+    if (invs[(std::size_t)k].empty())
+        divMod(x, d, q, r);
+    else
+        divModBarrett(x, d, invs[(std::size_t)k], q, r);
+
+    std::size_t lowDigits = (std::size_t)decChunkDigits << k;
+
+    toDecimalRecursive(q, pows, invs, k-1, padDigits>lowDigits ? padDigits-lowDigits : 0, out);
+    toDecimalRecursive(r, pows, invs, k-1, lowDigits, out);
+}
+
+//-----------------------------------------------------------------------------
+inline
+void toDecimal( const Limbs &x, std::string &out )
+{
+    if (x.size()<=decSplitThreshold)
+    {
+        toDecimalSimple(x, 0, out);
+        return;
+    }
+
+    // pows[k] = 10^(9*2^k); строим, пока pows[k+1] = pows[k]^2 не превысит x
+    std::vector<Limbs> pows;
+    pows.push_back(Limbs(1, decChunkDivisor));
+    for(;;)
+    {
+        const Limbs &last = pows.back();
+        if (last.size()*2 > x.size()+1)
+            break;
+        pows.push_back(mul(last, last));
+    }
+
+    // Обратные величины - только для степеней, делить на которые по Барретту выгоднее
+    std::vector<Limbs> invs(pows.size());
+    for(std::size_t k=0; k!=pows.size(); ++k)
+    {
+        if (pows[k].size()>=barrettThreshold)
+            invs[k] = reciprocal(pows[k]);
+    }
+
+    toDecimalRecursive(x, pows, invs, (int)pows.size()-1, 0, out);
+}
+
+//-----------------------------------------------------------------------------
+//! Основания 2, 8, 16 - цифры берутся непосредственно из битов
+inline
+void toPow2Base( const Limbs &x, unsigned bitsPerDigit, const char *digits, std::string &out )
+{
+    std::size_t totalBits = x.size()*32;
+    std::size_t numDigits = (totalBits + bitsPerDigit - 1)/bitsPerDigit;
+    unsigned    mask      = (1u<<bitsPerDigit) - 1u;
+
+    bool leading = true;
+    for(std::size_t d=numDigits; d--; )
+    {
+        std::size_t bitPos = d*bitsPerDigit;
+        std::size_t idx    = bitPos/32;
+        unsigned    sh     = (unsigned)(bitPos%32);
+
+        uint64_t w = x[idx];
+        if (idx+1<x.size())
+            w |= (uint64_t)x[idx+1]<<32;
+
+        unsigned dv = (unsigned)(w>>sh) & mask;
+        if (leading && !dv)
+            continue;
+
+        leading = false;
+        out.push_back(digits[dv]);
+    }
+}
+
+} // namespace bigint_impl
+
+
+//-----------------------------------------------------------------------------
+//! Цифры модуля числа в заданном основании (2, 8, 10, 16), без знака и префикса; для нуля - "0"
+template<typename LimbType>
+std::string bigIntToDigits( const BigIntView<LimbType> &v, int base, const char *digits )
+{
+    bigint_impl::Limbs x = bigint_impl::toLimbs32(v.limbs, v.count);
+
+    std::string res;
+
+    if (x.empty())
+    {
+        res.push_back('0');
+        return res;
+    }
+
+    switch(base)
+    {
+        case 2 : bigint_impl::toPow2Base(x, 1, digits, res); break;
+        case 8 : bigint_impl::toPow2Base(x, 3, digits, res); break;
+        case 16: bigint_impl::toPow2Base(x, 4, digits, res); break;
+        default: bigint_impl::toDecimal(x, res);
+    }
+
+    return res;
+}
+
+
+} // namespace format_utils
+
+
+//-----------------------------------------------------------------------------
+//! Создает представление целого числа произвольной разрядности для вывода в SimpleFormatter
+template<typename LimbType>
+format_utils::BigIntView<LimbType> bigint_view( const LimbType *limbs, std::size_t count, bool negative = false )
+{
+    format_utils::BigIntView<LimbType> v;
+    v.limbs    = limbs;
+    v.count    = count;
+    v.negative = negative;
+    return v;
+}
+
+
+} // namespace umba
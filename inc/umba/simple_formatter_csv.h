@@ -0,0 +1,321 @@
+/*! \file
+\brief Запись таблиц в формате CSV/TSV (RFC 4180) через SimpleFormatter
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED)
+    #include <string>
+#endif
+
+
+namespace umba
+{
+
+namespace csv
+{
+
+class CsvWriter;
+
+//-----------------------------------------------------------------------------
+//! Манипулятор конца записи: w << a << b << csv::endr;
+typedef CsvWriter& (*CsvManip)(CsvWriter &w);
+
+inline CsvWriter& endr( CsvWriter &w );
+
+
+
+//-----------------------------------------------------------------------------
+//! Построчная запись CSV/TSV
+/*! Строковые поля выводятся как есть, если в них нет разделителя, кавычки, CR или LF (поиск - SIMD-сканером),
+    иначе поле заключается в кавычки, а кавычки внутри удваиваются.
+
+    Числа и bool форматируются движками SimpleFormatter с FormatState столбца. Состояния столбцов задаются
+    один раз на экспорт (setColumnFormats); для столбцов без заданного состояния используется FormatState
+    по умолчанию. Может ли число в столбце содержать разделитель (десятичная точка, разделитель разрядов
+    или символ заполнения совпадают с разделителем полей), вычисляется заранее - такие числа заключаются в кавычки.
+    Состояния, при которых число содержит кавычку, не поддерживаются.
+
+    Если вывод форматтера заблокирован, поля не форматируются
+ */
+class CsvWriter
+{
+
+public:
+
+    typedef SimpleFormatter::FormatState FormatState;
+
+    //! Количество столбцов, для которых признак кавычек числовых полей хранится в битовой маске
+    static const std::size_t maxPrecomputedColumns = 64;
+
+    //! sep - разделитель полей: ',' (CSV), ';' или '\t' (TSV). crlf - окончание записи "\r\n" (RFC 4180) или "\n"
+    CsvWriter( SimpleFormatter &fmt, char sep = ',', bool crlf = true )
+    : m_fmt(fmt)
+    , m_sep(sep)
+    , m_crlf(crlf)
+    {
+        m_defaultNeedQuote = isNumQuoteNeeded(m_defaultState);
+    }
+
+    //! Задает форматы числовых столбцов. Массив не копируется и должен оставаться действительным во время экспорта
+    void setColumnFormats( const FormatState *pStates, std::size_t numStates )
+    {
+        m_pColStates    = pStates;
+        m_numColStates  = pStates ? numStates : 0;
+        m_numQuoteMask  = 0;
+
+        for(std::size_t i=0; i!=m_numColStates && i!=maxPrecomputedColumns; ++i)
+        {
+            if (isNumQuoteNeeded(m_pColStates[i]))
+                m_numQuoteMask |= (uint64_t)1 << i;
+        }
+    }
+
+    //-------------------
+    CsvWriter& field( const char *str )
+    {
+        return field(str, str ? std::strlen(str) : 0);
+    }
+
+    CsvWriter& field( const char *str, std::size_t len )
+    {
+        if (beginField())
+            writeString(str, len);
+        return *this;
+    }
+
+    CsvWriter& field( char *str )
+    {
+        return field((const char*)str);
+    }
+
+    #if !defined(UMBA_MCU_USED)
+    CsvWriter& field( const std::string &str )
+    {
+        return field(str.data(), str.size());
+    }
+    #endif
+
+    //! Символ - как строка из одного символа
+    CsvWriter& field( char ch )
+    {
+        return field(&ch, 1);
+    }
+
+    //! Пустое поле
+    CsvWriter& field()
+    {
+        beginField();
+        return *this;
+    }
+
+    //! Числа (целые, с плавающей точкой) и bool - в формате столбца
+    template< typename T >
+    typename std::enable_if< std::is_arithmetic<T>::value, CsvWriter& >::type
+    field( T v )
+    {
+        if (!beginField())
+            return *this;
+
+        std::size_t col = m_col - 1;
+        const FormatState &st = getColumnState(col);
+
+        bool quote = isColumnNumQuoted(col);
+        if (quote)
+            m_fmt.writeBuf("\"", 1);
+
+        // Состояние столбца передается движку напрямую - состояние форматтера не меняется
+        writeNumber(v, st);
+
+        if (quote)
+            m_fmt.writeBuf("\"", 1);
+
+        return *this;
+    }
+
+    //! Конец записи
+    CsvWriter& endRecord()
+    {
+        m_col = 0;
+        if (!m_fmt.isOutputEnabled())
+            return *this;
+
+        if (m_crlf)
+            m_fmt.writeBuf("\r\n", 2);
+        else
+            m_fmt.writeBuf("\n", 1);
+
+        m_fmt.requestFlush();
+        return *this;
+    }
+
+    //-------------------
+    template< typename T >
+    CsvWriter& operator<<( const T &v )
+    {
+        return field(v);
+    }
+
+    CsvWriter& operator<<( CsvManip manip )
+    {
+        return manip(*this);
+    }
+
+
+protected:
+
+    //-------------------
+    template< typename T >
+    typename std::enable_if< std::is_integral<T>::value && std::is_signed<T>::value >::type
+    writeNumber( T v, const FormatState &st )
+    {
+        m_fmt.formatSignedValue(v, st);
+    }
+
+    template< typename T >
+    typename std::enable_if< std::is_integral<T>::value && std::is_unsigned<T>::value >::type
+    writeNumber( T v, const FormatState &st )
+    {
+        m_fmt.formatUnsignedValue(v, st);
+    }
+
+    template< typename T >
+    typename std::enable_if< std::is_floating_point<T>::value >::type
+    writeNumber( T v, const FormatState &st )
+    {
+        m_fmt.formatFloatValue(v, st);
+    }
+
+    //! bool - как SimpleFormatter::formatValue(bool): 0/1 или, с boolalpha, false/true
+    void writeNumber( bool b, const FormatState &st )
+    {
+        static const char* bools[] = { "0", "1"
+                                     , "false", "true"
+                                     , "FALSE", "TRUE"
+                                     };
+        unsigned idx = (unsigned)(b ? 1 : 0);
+        if (st.flags&SimpleFormatter::boolalpha)
+        {
+            idx += 2;
+            if (st.flags&SimpleFormatter::uppercase)
+                idx += 2;
+        }
+
+        m_fmt.formatStringValue(bools[idx], st);
+    }
+
+    //-------------------
+    //! Разделитель перед всеми полями, кроме первого. Возвращает false, если вывод заблокирован
+    bool beginField()
+    {
+        bool enabled = m_fmt.isOutputEnabled();
+        if (enabled && m_col)
+            m_fmt.writeBuf(&m_sep, 1);
+        ++m_col;
+        return enabled;
+    }
+
+    //-------------------
+    void writeString( const char *str, std::size_t len )
+    {
+        std::size_t specialPos = format_utils::findAnyOf4(str, len, m_sep, '"', '\r', '\n');
+        if (specialPos==len)
+        {
+            // Обычный случай - поле копируется целиком, без кавычек
+            m_fmt.writeBuf(str, len);
+            return;
+        }
+
+        m_fmt.writeBuf("\"", 1);
+
+        // Префикс без спецсимволов уже известен - кавычки ищем только начиная с первого спецсимвола
+        m_fmt.writeBuf(str, specialPos);
+        str += specialPos;
+        len -= specialPos;
+
+        while(len)
+        {
+            const char *pQuote = (const char*)std::memchr(str, '"', len);
+            if (!pQuote)
+            {
+                m_fmt.writeBuf(str, len);
+                break;
+            }
+
+            std::size_t runLen = (std::size_t)(pQuote - str) + 1;
+            m_fmt.writeBuf(str, runLen); // включая кавычку
+            m_fmt.writeBuf("\"", 1);     // и удваиваем ее
+            str += runLen;
+            len -= runLen;
+        }
+
+        m_fmt.writeBuf("\"", 1);
+    }
+
+    //-------------------
+    const FormatState& getColumnState( std::size_t col ) const
+    {
+        return col<m_numColStates ? m_pColStates[col] : m_defaultState;
+    }
+
+    bool isColumnNumQuoted( std::size_t col ) const
+    {
+        if (col>=m_numColStates)
+            return m_defaultNeedQuote;
+        if (col<maxPrecomputedColumns)
+            return (m_numQuoteMask & ((uint64_t)1 << col))!=0;
+        return isNumQuoteNeeded(m_pColStates[col]);
+    }
+
+    bool isSpecialChar( char ch ) const
+    {
+        return ch==m_sep || ch=='\r' || ch=='\n';
+    }
+
+    //! Может ли число, отформатированное с состоянием st, содержать спецсимвол CSV
+    bool isNumQuoteNeeded( const FormatState &st ) const
+    {
+        return isSpecialChar(st.decimalPoint)
+            || isSpecialChar(st.fill)
+            || (st.decGroupSize>0 && isSpecialChar(st.decGroupSep))
+            || (st.groupSize>0    && isSpecialChar(st.groupSep))
+            ;
+    }
+
+
+    // disable copying
+    CsvWriter(const CsvWriter&);
+    CsvWriter& operator=(const CsvWriter&);
+
+
+    SimpleFormatter      &m_fmt;
+    char                  m_sep;
+    bool                  m_crlf;
+
+    std::size_t           m_col          = 0;
+
+    FormatState           m_defaultState;
+    bool                  m_defaultNeedQuote = false;
+
+    const FormatState    *m_pColStates   = 0;
+    std::size_t           m_numColStates = 0;
+    uint64_t              m_numQuoteMask = 0;
+
+}; // class CsvWriter
+
+
+
+//-----------------------------------------------------------------------------
+inline
+CsvWriter& endr( CsvWriter &w )
+{
+    return w.endRecord();
+}
+
+
+} // namespace csv
+
+} // namespace umba
+
@@ -0,0 +1,301 @@
+/*! \file
+\brief Структурированный вывод в формате JSON lines (одна JSON-запись на строку) через SimpleFormatter
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED)
+    #include <cstdio>
+    #include <cstdlib>
+    #include <string>
+#endif
+
+
+namespace umba
+{
+
+namespace json
+{
+
+//-----------------------------------------------------------------------------
+//! Пара ключ-значение для вывода в JsonLine
+/*! Числа, bool и указатели хранятся по значению; строки и прочие объекты - по ссылке,
+    поэтому пару с временной строкой нужно выводить в том же выражении, где она создана
+ */
+template<typename T>
+struct JsonKv
+{
+    typedef typename std::conditional< std::is_scalar<T>::value, T, const T& >::type value_type;
+
+    const char  *key;
+    value_type   value;
+
+}; // struct JsonKv
+
+//-----------------------------------------------------------------------------
+//! Создает пару ключ-значение: line << json::kv("id", 5) << json::kv("msg", str);
+template<typename T>
+JsonKv<T> kv( const char *key, const T &value )
+{
+    JsonKv<T> res = { key, value };
+    return res;
+}
+
+
+
+//-----------------------------------------------------------------------------
+//! Одна запись JSON lines: '{' выводится в конструкторе, '}' и перевод строки - в деструкторе
+/*! Целые числа форматируются теми же движками SimpleFormatter через спецификацию времени компиляции
+    (umba::spec), поэтому текущее состояние форматтера (hex, width, группировка и т.п.) на вывод не влияет.
+    Плавающая точка на хосте выводится без потери точности (см. writeValue).
+    Строки экранируются с поиском спецсимволов SIMD-сканером; участки без спецсимволов копируются целиком.
+    Если вывод форматтера заблокирован, запись не формируется
+ */
+class JsonLine
+{
+
+public:
+
+    JsonLine( SimpleFormatter &fmt )
+    : m_fmt(fmt)
+    , m_enabled(fmt.isOutputEnabled())
+    , m_first(true)
+    {
+        if (m_enabled)
+            m_fmt.writeBuf("{", 1);
+    }
+
+    ~JsonLine()
+    {
+        if (!m_enabled)
+            return;
+        m_fmt.writeBuf("}", 1);
+        m_fmt << omanip::endl;
+    }
+
+    //-------------------
+    template<typename T>
+    JsonLine& kv( const char *key, const T &value )
+    {
+        if (!m_enabled)
+            return *this;
+
+        if (!m_first)
+            m_fmt.writeBuf(",", 1);
+        m_first = false;
+
+        // Ключ null в JSON недопустим - выводится пустой ключ
+        if (key)
+            writeString(key);
+        else
+            m_fmt.writeBuf("\"\"", 2);
+        m_fmt.writeBuf(":", 1);
+        writeValue(value);
+
+        return *this;
+    }
+
+    template<typename T>
+    JsonLine& operator<<( const JsonKv<T> &p )
+    {
+        return kv(p.key, p.value);
+    }
+
+
+protected:
+
+    //-------------------
+    void writeString( const char *str, std::size_t len )
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+
+        m_fmt.writeBuf("\"", 1);
+
+        while(len)
+        {
+            std::size_t cleanLen = format_utils::findJsonSpecialChar(str, len);
+            if (cleanLen)
+            {
+                m_fmt.writeBuf(str, cleanLen);
+                str += cleanLen;
+                len -= cleanLen;
+                if (!len)
+                    break;
+            }
+
+            char esc[6] = { '\\', 0, 0, 0, 0, 0 };
+            std::size_t escLen = 2;
+
+            unsigned char ch = (unsigned char)*str;
+            switch(ch)
+            {
+                case '"' : esc[1] = '"';  break;
+                case '\\': esc[1] = '\\'; break;
+                case '\n': esc[1] = 'n';  break;
+                case '\r': esc[1] = 'r';  break;
+                case '\t': esc[1] = 't';  break;
+                case '\b': esc[1] = 'b';  break;
+                case '\f': esc[1] = 'f';  break;
+                default:
+                     esc[1] = 'u';
+                     esc[2] = '0';
+                     esc[3] = '0';
+                     esc[4] = hexDigits[ch>>4];
+                     esc[5] = hexDigits[ch&0xF];
+                     escLen = 6;
+            }
+
+            m_fmt.writeBuf(esc, escLen);
+            ++str;
+            --len;
+        }
+
+        m_fmt.writeBuf("\"", 1);
+    }
+
+    void writeString( const char *str )
+    {
+        if (!str)
+        {
+            m_fmt.writeBuf("null", 4);
+            return;
+        }
+        writeString(str, std::strlen(str));
+    }
+
+    //-------------------
+    void writeValue( const char *str )
+    {
+        writeString(str);
+    }
+
+    void writeValue( char *str )
+    {
+        writeString(str);
+    }
+
+    template<std::size_t N>
+    void writeValue( const char (&str)[N] )
+    {
+        writeString(str);
+    }
+
+    #if !defined(UMBA_MCU_USED)
+    void writeValue( const std::string &str )
+    {
+        writeString(str.data(), str.size());
+    }
+    #endif
+
+    void writeValue( bool b )
+    {
+        if (b)
+            m_fmt.writeBuf("true", 4);
+        else
+            m_fmt.writeBuf("false", 5);
+    }
+
+    void writeValue( std::nullptr_t )
+    {
+        m_fmt.writeBuf("null", 4);
+    }
+
+    //! Символ выводится как строка из одного символа
+    void writeValue( char ch )
+    {
+        writeString(&ch, 1);
+    }
+
+    template< typename IntType >
+    typename std::enable_if< std::is_integral<IntType>::value >::type
+    writeValue( IntType v )
+    {
+        m_fmt << umba::spec<SimpleFormatter::dec>(v);
+    }
+
+    #if defined(UMBA_SIMPLE_FORMATTER_INT128_SUPPORTED)
+    void writeValue( format_utils::int128_t v )
+    {
+        m_fmt << umba::spec<SimpleFormatter::dec>(v);
+    }
+
+    void writeValue( format_utils::uint128_t v )
+    {
+        m_fmt << umba::spec<SimpleFormatter::dec>(v);
+    }
+    #endif
+
+    //! Плавающая точка. На хосте - кратчайшее представление, из которого значение восстанавливается точно (snprintf "%.Ng")
+    /*! Для MCU - движком SimpleFormatter с 6 знаками после точки, пока значение помещается в его диапазон.
+        NaN и бесконечности в JSON не представимы и выводятся как null
+     */
+    template< typename FloatType >
+    typename std::enable_if< std::is_floating_point<FloatType>::value >::type
+    writeValue( FloatType v )
+    {
+        if (std::isnan(v) || std::isinf(v))
+        {
+            m_fmt.writeBuf("null", 4);
+            return;
+        }
+
+        #if !defined(UMBA_MCU_USED)
+
+            // Точности, достаточные для float/double (FLT_DIG..FLT_DECIMAL_DIG, DBL_DIG..DBL_DECIMAL_DIG)
+            const int minPrec = sizeof(FloatType)<=sizeof(float) ? 6 : 15;
+            const int maxPrec = sizeof(FloatType)<=sizeof(float) ? 9 : 17;
+
+            char buf[40];
+            int  n = 0;
+            for(int prec=minPrec; prec<=maxPrec; ++prec)
+            {
+                n = std::snprintf(buf, sizeof(buf), "%.*g", prec, (double)v);
+                if (n<=0 || n>=(int)sizeof(buf))
+                    return;
+                if (prec==maxPrec || (FloatType)std::strtod(buf, 0)==v)
+                    break;
+            }
+
+            // Десятичный разделитель snprintf/strtod зависит от локали, в JSON - только точка
+            for(int i=0; i!=n; ++i)
+            {
+                if (buf[i]!='-' && buf[i]!='+' && buf[i]!='e' && (buf[i]<'0' || buf[i]>'9'))
+                    buf[i] = '.';
+            }
+
+            m_fmt.writeBuf(buf, (std::size_t)n);
+
+        #else
+
+            if (v<(FloatType)maxEngineFloat && v>-(FloatType)maxEngineFloat)
+                m_fmt << umba::spec<SimpleFormatter::dec, 0, ' ', 6>(v);
+            else
+                m_fmt.writeBuf("null", 4);
+
+        #endif
+    }
+
+    #if defined(UMBA_MCU_USED)
+    //! Максимальное по модулю значение, которое движок SimpleFormatter выводит с точностью 6 (ограничение uint64_t)
+    static constexpr double maxEngineFloat = 1e12;
+    #endif
+
+
+    // disable copying
+    JsonLine(const JsonLine&);
+    JsonLine& operator=(const JsonLine&);
+
+
+    SimpleFormatter    &m_fmt;
+    bool                m_enabled;
+    bool                m_first;
+
+}; // class JsonLine
+
+
+} // namespace json
+
+} // namespace umba
+
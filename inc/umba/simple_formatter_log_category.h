@@ -0,0 +1,269 @@
+/*! \file
+\brief Категории логов с уровнями фильтрации, изменяемыми во время выполнения
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+
+#include "umba/simple_formatter.h"
+
+
+//! Максимальное количество категорий логов
+#if !defined(UMBA_LOG_MAX_CATEGORIES)
+    #define UMBA_LOG_MAX_CATEGORIES 64
+#endif
+
+
+namespace umba
+{
+
+namespace log_utils
+{
+
+//-----------------------------------------------------------------------------
+//! Реестр именованных категорий логов
+/*! Каждой категории при регистрации выдается небольшой целый идентификатор - индекс в массиве
+    атомарных уровней. Проверка уровня - одна relaxed-загрузка и сравнение, изменение уровня
+    (например, при перечитывании конфига) - одна атомарная запись, без блокировок.
+
+    Регистрация (обычно при статической инициализации) защищена спин-блокировкой на atomic_flag,
+    т.к. требует поиска имени. Имена категорий не копируются - это должны быть строковые литералы
+    или другие строки со статическим временем жизни
+ */
+class LogCategoryRegistry
+{
+
+public:
+
+    static const int maxCategories     = UMBA_LOG_MAX_CATEGORIES;
+    static const int invalidCategoryId = -1;
+
+    LogCategoryRegistry()
+    {
+        for(int i=0; i!=maxCategories; ++i)
+        {
+            m_levels[i].store((int)ColoringLevel::debug, std::memory_order_relaxed);
+            m_names[i] = 0;
+        }
+    }
+
+    //! Регистрирует категорию, или возвращает идентификатор уже зарегистрированной с тем же именем
+    /*! При переполнении реестра возвращается invalidCategoryId
+     */
+    int registerCategory( const char *name, ColoringLevel defLevel = ColoringLevel::debug )
+    {
+        RegistrationLock lock(m_regLock);
+
+        int cnt = m_count.load(std::memory_order_relaxed);
+
+        int id = findCategoryImpl(name, cnt);
+        if (id!=invalidCategoryId)
+            return id;
+
+        if (cnt>=maxCategories)
+            return invalidCategoryId;
+
+        m_names[cnt] = name;
+        m_levels[cnt].store((int)severity(defLevel), std::memory_order_relaxed);
+        m_count.store(cnt+1, std::memory_order_release);
+
+        return cnt;
+    }
+
+    //! Поиск категории по имени, invalidCategoryId, если не найдена
+    int findCategory( const char *name ) const
+    {
+        return findCategoryImpl(name, m_count.load(std::memory_order_acquire));
+    }
+
+    int size() const
+    {
+        return m_count.load(std::memory_order_acquire);
+    }
+
+    const char* getName( int id ) const
+    {
+        return isValidId(id) ? m_names[id] : "";
+    }
+
+    //! Указатель на атомарный уровень категории - для кеширования в LogCategory
+    const std::atomic<int>* getLevelPtr( int id ) const
+    {
+        return isValidId(id) ? &m_levels[id] : &m_disabledLevel;
+    }
+
+    ColoringLevel getLevel( int id ) const
+    {
+        return (ColoringLevel)getLevelPtr(id)->load(std::memory_order_relaxed);
+    }
+
+    void setLevel( int id, ColoringLevel lvl )
+    {
+        if (isValidId(id))
+            m_levels[id].store((int)severity(lvl), std::memory_order_relaxed);
+    }
+
+    //! Установка уровня по имени категории. Возвращает false, если категория не найдена
+    bool setLevel( const char *name, ColoringLevel lvl )
+    {
+        int id = findCategory(name);
+        if (id==invalidCategoryId)
+            return false;
+        setLevel(id, lvl);
+        return true;
+    }
+
+    void setAllLevels( ColoringLevel lvl )
+    {
+        int cnt = size();
+        for(int i=0; i!=cnt; ++i)
+            setLevel(i, lvl);
+    }
+
+    bool isEnabled( int id, ColoringLevel lvl ) const
+    {
+        return (int)severity(lvl) <= getLevelPtr(id)->load(std::memory_order_relaxed);
+    }
+
+
+protected:
+
+    //-------------------
+    class RegistrationLock
+    {
+    public:
+        RegistrationLock( std::atomic_flag &flag ) : m_flag(flag)
+        {
+            while(m_flag.test_and_set(std::memory_order_acquire)) {}
+        }
+
+        ~RegistrationLock()
+        {
+            m_flag.clear(std::memory_order_release);
+        }
+
+    private:
+        // disable copying
+        RegistrationLock(const RegistrationLock&);
+        RegistrationLock& operator=(const RegistrationLock&);
+
+        std::atomic_flag &m_flag;
+    };
+
+    //-------------------
+    bool isValidId( int id ) const
+    {
+        return id>=0 && id<m_count.load(std::memory_order_acquire);
+    }
+
+    int findCategoryImpl( const char *name, int cnt ) const
+    {
+        for(int i=0; i!=cnt; ++i)
+        {
+            if (std::strcmp(m_names[i], name)==0)
+                return i;
+        }
+        return invalidCategoryId;
+    }
+
+
+    // disable copying
+    LogCategoryRegistry(const LogCategoryRegistry&);
+    LogCategoryRegistry& operator=(const LogCategoryRegistry&);
+
+
+    std::atomic<int>    m_levels[maxCategories];
+    const char*         m_names[maxCategories];
+    std::atomic<int>    m_count{0};
+    std::atomic_flag    m_regLock = ATOMIC_FLAG_INIT;
+
+    //! Уровень для незарегистрированных категорий - вывод запрещен
+    std::atomic<int>    m_disabledLevel{-1};
+
+}; // class LogCategoryRegistry
+
+//-----------------------------------------------------------------------------
+//! Глобальный реестр категорий логов
+inline
+LogCategoryRegistry& getLogCategoryRegistry()
+{
+    static LogCategoryRegistry registry;
+    return registry;
+}
+
+
+
+//-----------------------------------------------------------------------------
+//! Категория логов. Обычно объявляется статической переменной (см. UMBA_LOG_DEFINE_CATEGORY)
+/*! Хранит указатель на свой атомарный уровень в реестре, поэтому проверка
+    не обращается к реестру и сводится к одной relaxed-загрузке и сравнению
+ */
+class LogCategory
+{
+
+public:
+
+    LogCategory( const char *name, ColoringLevel defLevel = ColoringLevel::debug )
+    : m_id( getLogCategoryRegistry().registerCategory(name, defLevel) )
+    , m_pLevel( getLogCategoryRegistry().getLevelPtr(m_id) )
+    {}
+
+    int id() const
+    {
+        return m_id;
+    }
+
+    const char* name() const
+    {
+        return getLogCategoryRegistry().getName(m_id);
+    }
+
+    ColoringLevel level() const
+    {
+        return (ColoringLevel)m_pLevel->load(std::memory_order_relaxed);
+    }
+
+    void level( ColoringLevel lvl )
+    {
+        getLogCategoryRegistry().setLevel(m_id, lvl);
+    }
+
+    bool isEnabled( ColoringLevel lvl ) const
+    {
+        return (int)severity(lvl) <= m_pLevel->load(std::memory_order_relaxed);
+    }
+
+
+protected:
+
+    int                       m_id;
+    const std::atomic<int>   *m_pLevel;
+
+}; // class LogCategory
+
+
+} // namespace log_utils
+
+} // namespace umba
+
+
+
+//-----------------------------------------------------------------------------
+//! Определение категории логов: UMBA_LOG_DEFINE_CATEGORY(netLog, "net", warning)
+#define UMBA_LOG_DEFINE_CATEGORY( varName, catName, defLvl ) \
+    umba::log_utils::LogCategory varName( catName, umba::ColoringLevel::defLvl )
+
+//-----------------------------------------------------------------------------
+//! Вывод сообщения уровня lvl в категории cat (объект LogCategory)
+/*! Пример: UMBA_LOG_CAT(umba::lout, netLog, debug) << "rx: " << n << umba::omanip::endl;
+
+    Уровень категории заменяет уровень SimpleFormatter::logLevel(), что позволяет включить отладочный
+    вывод только для одной подсистемы. Ограничение UMBA_LOG_MIN_LEVEL времени компиляции действует как в UMBA_LOG
+ */
+#define UMBA_LOG_CAT( fmt, cat, lvl )                                                                     \
+    if ( !umba::log_utils::isLevelCompiled(umba::ColoringLevel::lvl)                                      \
+      || !(cat).isEnabled(umba::ColoringLevel::lvl) ) {}                                                 \
+    else (fmt) << umba::omanip::coloring(umba::ColoringLevel::lvl)
+
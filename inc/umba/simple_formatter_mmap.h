@@ -0,0 +1,282 @@
+/*! \file
+\brief Устройство вывода в файл через отображение в память (mmap), для больших объемов вывода (только POSIX)
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED) && (defined(__unix__) || defined(__APPLE__))
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Устройство вывода в файл через отображение окна файла в память
+/*! Файл заранее увеличивается (posix_fallocate; ftruncate - если ФС его не поддерживает) на шаг роста, окно файла
+    отображается в память, вывод форматтера копируется прямо в отображение (memcpy), без системных
+    вызовов. При заполнении окна файл увеличивается на следующий шаг и отображается следующее окно.
+    При закрытии файл усекается до фактического размера выведенных данных.
+
+    flush() ничего не делает - данные уже находятся в страничном кэше и видны другим процессам.
+    Для записи на диск используйте sync().
+
+    Если место под следующий шаг роста не удается зарезервировать (нет места на диске), дальнейший вывод
+    отбрасывается - файл не отображается без резервирования, т.к. запись в такое отображение на полном
+    диске приводит к SIGBUS. Без резервирования (ftruncate) файл увеличивается только на ФС, которые
+    не поддерживают posix_fallocate, и на macOS.
+
+    Ошибки (открытие, увеличение, отображение) не прерывают работу: дальнейший вывод отбрасывается,
+    код ошибки доступен через getLastError()
+ */
+class MmapFileCharWriter : public ICharWriter
+{
+
+public:
+
+    //! Размер окна (и шага роста файла) по умолчанию
+    static const std::size_t defaultWindowSize = 16u*1024u*1024u;
+
+    MmapFileCharWriter()
+    {}
+
+    //! windowSize - размер отображаемого окна и шаг роста файла (округляется до размера страницы)
+    explicit MmapFileCharWriter( const char *fileName, std::size_t windowSize = defaultWindowSize )
+    {
+        open(fileName, windowSize);
+    }
+
+    ~MmapFileCharWriter()
+    {
+        close();
+    }
+
+    //-------------------
+    //! Создает (или перезаписывает) файл. Возвращает false при ошибке
+    bool open( const char *fileName, std::size_t windowSize = defaultWindowSize )
+    {
+        close();
+
+        m_lastError = 0;
+
+        long pageSize = ::sysconf(_SC_PAGESIZE);
+        m_pageSize    = pageSize>0 ? (std::size_t)pageSize : 4096u;
+        m_windowSize  = roundUpToPage(windowSize ? windowSize : defaultWindowSize);
+
+        m_fd = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd<0)
+        {
+            m_lastError = errno;
+            return false;
+        }
+
+        return mapWindow(0);
+    }
+
+    //! Отображение снимается, файл усекается до фактического размера и закрывается
+    void close()
+    {
+        if (m_fd<0)
+            return;
+
+        unmapWindow();
+
+        if (::ftruncate(m_fd, (off_t)m_size)!=0 && !m_lastError)
+            m_lastError = errno;
+
+        ::close(m_fd);
+
+        m_fd       = -1;
+        m_size     = 0;
+        m_fileSize = 0;
+    }
+
+    bool isOpen() const
+    {
+        return m_fd>=0;
+    }
+
+    //! Количество выведенных байт
+    uint64_t getSize() const
+    {
+        return m_size;
+    }
+
+    //! errno последней ошибки (0 - ошибок не было)
+    int getLastError() const
+    {
+        return m_lastError;
+    }
+
+    //! Синхронная запись всех выведенных данных на диск (текущее окно и ранее снятые с отображения)
+    bool sync()
+    {
+        if (m_fd<0)
+            return false;
+        if (m_pWindow && ::msync(m_pWindow, m_windowLen, MS_SYNC)!=0)
+            return false;
+        #if defined(__APPLE__)
+            return ::fsync(m_fd)==0;
+        #else
+            return ::fdatasync(m_fd)==0;
+        #endif
+    }
+
+    //-------------------
+    virtual void writeChar( char ch ) override
+    {
+        if (m_pCur==m_pEnd && !nextWindow())
+            return;
+
+        *m_pCur++ = (uint8_t)ch;
+        ++m_size;
+    }
+
+    virtual void writeBuf( const uint8_t* pBuf, size_t len ) override
+    {
+        while(len)
+        {
+            if (m_pCur==m_pEnd && !nextWindow())
+                return;
+
+            std::size_t avail = (std::size_t)(m_pEnd - m_pCur);
+            std::size_t chunk = len<avail ? len : avail;
+
+            std::memcpy(m_pCur, pBuf, chunk);
+            m_pCur += chunk;
+            m_size += chunk;
+            pBuf   += chunk;
+            len    -= chunk;
+        }
+    }
+
+    virtual void flush() override
+    {
+    }
+
+
+protected:
+
+    std::size_t roundUpToPage( std::size_t sz ) const
+    {
+        return (sz + m_pageSize - 1) / m_pageSize * m_pageSize;
+    }
+
+    //-------------------
+    //! Увеличивает файл так, чтобы он вмещал newFileSize байт
+    bool growFile( uint64_t newFileSize )
+    {
+        if (newFileSize<=m_fileSize)
+            return true;
+
+        #if defined(__linux__)
+            // posix_fallocate возвращает код ошибки, а не -1/errno
+            int err = ::posix_fallocate(m_fd, (off_t)m_fileSize, (off_t)(newFileSize-m_fileSize));
+            if (!err)
+            {
+                m_fileSize = newFileSize;
+                return true;
+            }
+
+            // Нет места (ENOSPC, EFBIG и т.п.) - ошибка: запись в разреженное отображение на полном диске вызовет SIGBUS
+            if (err!=EOPNOTSUPP && err!=EINVAL)
+            {
+                m_lastError = err;
+                return false;
+            }
+        #endif
+
+        // ФС без поддержки резервирования места - разреженный файл
+        if (::ftruncate(m_fd, (off_t)newFileSize)!=0)
+        {
+            m_lastError = errno;
+            return false;
+        }
+
+        m_fileSize = newFileSize;
+        return true;
+    }
+
+    //! Отображает окно файла, начинающееся с позиции offset (кратна размеру страницы)
+    bool mapWindow( uint64_t offset )
+    {
+        if (!growFile(offset + m_windowSize))
+            return false;
+
+        void *p = ::mmap(0, m_windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, (off_t)offset);
+        if (p==MAP_FAILED)
+        {
+            m_lastError = errno;
+            return false;
+        }
+
+        m_pWindow      = (uint8_t*)p;
+        m_windowLen    = m_windowSize;
+        m_windowOffset = offset;
+        m_pCur         = m_pWindow + (std::size_t)(m_size - offset);
+        m_pEnd         = m_pWindow + m_windowLen;
+
+        return true;
+    }
+
+    void unmapWindow()
+    {
+        if (m_pWindow)
+            ::munmap(m_pWindow, m_windowLen);
+
+        m_pWindow   = 0;
+        m_windowLen = 0;
+        m_pCur      = 0;
+        m_pEnd      = 0;
+    }
+
+    //! Окно заполнено - отображаем следующее. Возвращает false, если вывод невозможен
+    bool nextWindow()
+    {
+        if (m_fd<0 || m_lastError)
+            return false;
+
+        unmapWindow();
+
+        // Текущая позиция окна заполнена целиком, поэтому она уже кратна размеру страницы
+        return mapWindow(m_size / m_pageSize * m_pageSize);
+    }
+
+
+    // disable copying
+    MmapFileCharWriter(const MmapFileCharWriter&);
+    MmapFileCharWriter& operator=(const MmapFileCharWriter&);
+
+
+    int                 m_fd           = -1;
+    int                 m_lastError    = 0;
+
+    std::size_t         m_pageSize     = 4096;
+    std::size_t         m_windowSize   = defaultWindowSize;
+
+    uint8_t            *m_pWindow      = 0;
+    std::size_t         m_windowLen    = 0;
+    uint64_t            m_windowOffset = 0;
+    uint8_t            *m_pCur         = 0;
+    uint8_t            *m_pEnd         = 0;
+
+    uint64_t            m_size         = 0;   //!< выведено байт
+    uint64_t            m_fileSize     = 0;   //!< текущий размер файла (с запасом)
+
+}; // class MmapFileCharWriter
+
+
+} // namespace umba
+
+#endif // !UMBA_MCU_USED && POSIX
+
@@ -0,0 +1,327 @@
+/*! \file
+\brief Индикатор прогресса/спиннер с ограничением частоты перерисовки
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Индикатор прогресса (при известном общем количестве) или спиннер (при неизвестном)
+/*! Обновление в горячем цикле (++progress, add) - инкремент счетчика и декремент счетчика до проверки времени.
+    Время (FlushTickSource, монотонные миллисекунды) читается раз в m_checkStride обновлений; шаг подстраивается
+    так, чтобы проверки происходили несколько раз за интервал перерисовки. Перерисовка - не чаще
+    maxRedrawsPerSecond раз в секунду.
+
+    Вывод: "label [#####.....]  42% 4200/10000 1.5k/s ETA 00:04". Скорость - экспоненциальное скользящее среднее.
+    На терминале строка перерисовывается на месте (терминальные методы CharWriterProxy - через форматтер,
+    поэтому префикс строки выводится при каждой перерисовке, а в неблокирующем режиме перемещения курсора
+    не обгоняют данные в очереди), иначе каждая перерисовка выводится отдельной строкой.
+
+    Для MCU источник времени должен быть задан явно (например, HAL_GetTick), для хоста по умолчанию
+    используется std::chrono::steady_clock
+ */
+class ProgressIndicator
+{
+
+public:
+
+    //! total - общее количество (0 - неизвестно, выводится спиннер)
+    ProgressIndicator( SimpleFormatter &fmt, uint64_t total = 0, unsigned maxRedrawsPerSecond = 10, FlushTickSource tickSource = defaultTickSource() )
+    : m_fmt(fmt)
+    , m_tickSource(tickSource)
+    , m_total(total)
+    {
+        setRedrawRate(maxRedrawsPerSecond);
+        m_startTick = m_lastRedrawTick = m_lastCheckTick = getTick();
+    }
+
+    //! Метка, выводимая перед индикатором (ASCII-Z, не копируется). 0 - без метки
+    void setLabel( const char *label )
+    {
+        m_label = label;
+    }
+
+    //! Ширина полосы в символах
+    void setBarWidth( int barWidth )
+    {
+        m_barWidth = barWidth>0 ? barWidth : 0;
+    }
+
+    void setRedrawRate( unsigned maxRedrawsPerSecond )
+    {
+        m_redrawIntervalMs = maxRedrawsPerSecond ? 1000u/maxRedrawsPerSecond : 1000u;
+    }
+
+    void setTotal( uint64_t total )
+    {
+        m_total = total;
+    }
+
+    uint64_t current() const
+    {
+        return m_current;
+    }
+
+    //-------------------
+    //! Горячий путь - только инкремент и проверка счетчика до чтения времени
+    ProgressIndicator& operator++()
+    {
+        ++m_current;
+        if (--m_checkCountdown==0)
+            poll();
+        return *this;
+    }
+
+    ProgressIndicator& add( uint64_t n )
+    {
+        m_current += n;
+        if (--m_checkCountdown==0)
+            poll();
+        return *this;
+    }
+
+    ProgressIndicator& set( uint64_t value )
+    {
+        m_current = value;
+        if (--m_checkCountdown==0)
+            poll();
+        return *this;
+    }
+
+    //-------------------
+    //! Проверка времени и перерисовка, если интервал истек. Вызывается из горячего пути раз в m_checkStride обновлений
+    void poll()
+    {
+        uint32_t now     = getTick();
+        uint32_t sinceCk = now - m_lastCheckTick;
+        m_lastCheckTick  = now;
+
+        // Подстройка шага: несколько проверок времени за интервал перерисовки
+        uint32_t checkTarget = m_redrawIntervalMs/4;
+        if (sinceCk<checkTarget && m_checkStride<maxCheckStride)
+            m_checkStride *= 2;
+        else if (sinceCk>m_redrawIntervalMs && m_checkStride>1)
+            m_checkStride /= 2;
+        m_checkCountdown = m_checkStride;
+
+        if (now - m_lastRedrawTick >= m_redrawIntervalMs)
+            redraw(now);
+    }
+
+    //! Немедленная перерисовка
+    void redraw()
+    {
+        redraw(getTick());
+    }
+
+    //! Завершение: финальная перерисовка и перевод строки
+    void finish()
+    {
+        if (m_total)
+            m_current = m_total;
+        redraw(getTick());
+        if (m_fmt.isOutputEnabled() && m_fmt.getCharWritter()->isTerminal())
+            m_fmt << omanip::endl;
+    }
+
+
+protected:
+
+    static const uint32_t maxCheckStride = 1u<<20;
+
+    //-------------------
+    static FlushTickSource defaultTickSource()
+    {
+        #if !defined(UMBA_MCU_USED)
+            return flushTickSourceSteadyClock;
+        #else
+            return 0;
+        #endif
+    }
+
+    uint32_t getTick() const
+    {
+        return m_tickSource ? m_tickSource() : 0;
+    }
+
+    //-------------------
+    void updateRate( uint32_t now )
+    {
+        uint32_t dt = now - m_lastRedrawTick;
+        if (!dt)
+            return;
+
+        uint64_t delta = m_current>=m_lastRedrawCount ? m_current - m_lastRedrawCount : 0;
+        uint64_t inst  = delta*1000u/dt;
+
+        // EMA с коэффициентом 1/4 - без плавающей точки
+        if (!m_rateValid)
+        {
+            m_rate      = inst;
+            m_rateValid = true;
+        }
+        else
+        {
+            m_rate = (m_rate*3u + inst)/4u;
+        }
+    }
+
+    void redraw( uint32_t now )
+    {
+        updateRate(now);
+        m_lastRedrawTick  = now;
+        m_lastRedrawCount = m_current;
+
+        if (!m_fmt.isOutputEnabled())
+            return;
+
+        ICharWriter *pWriter = m_fmt.getCharWritter();
+        bool isTerm = pWriter->isTerminal();
+        if (isTerm)
+            pWriter->terminalMoveToLineStart();
+
+        if (m_label)
+            m_fmt << m_label << " ";
+
+        if (m_total)
+            writeBar();
+        else
+            writeSpinner();
+
+        writeRate();
+
+        if (isTerm)
+        {
+            pWriter->terminalClearLineEnd();
+            m_fmt.flush();
+        }
+        else
+        {
+            m_fmt << omanip::endl;
+        }
+    }
+
+    //-------------------
+    void writeBar()
+    {
+        uint64_t cur = m_current<m_total ? m_current : m_total;
+
+        char buf[64];
+        int  barW   = m_barWidth < (int)sizeof(buf)-2 ? m_barWidth : (int)sizeof(buf)-2;
+        int  filled = (int)(cur*(uint64_t)barW/m_total);
+
+        buf[0] = '[';
+        for(int i=0; i!=barW; ++i)
+            buf[1+i] = i<filled ? '#' : '.';
+        buf[1+barW] = ']';
+        m_fmt.writeBuf(&buf[0], (std::size_t)barW+2);
+
+        m_fmt << " " << umba::spec<SimpleFormatter::dec, 3>((unsigned)(cur*100u/m_total)) << "% "
+              << umba::spec<SimpleFormatter::dec>(m_current) << "/" << umba::spec<SimpleFormatter::dec>(m_total);
+    }
+
+    void writeSpinner()
+    {
+        static const char spinnerChars[] = { '-', '\\', '|', '/' };
+        m_fmt.writeBuf(&spinnerChars[m_spinnerPos++ & 3], 1);
+        m_fmt << " " << umba::spec<SimpleFormatter::dec>(m_current);
+    }
+
+    void writeRate()
+    {
+        if (!m_rateValid)
+            return;
+
+        m_fmt << " ";
+        writeScaled(m_rate);
+        m_fmt << "/s";
+
+        if (m_total)
+        {
+            if (m_current<m_total && m_rate)
+            {
+                m_fmt << " ETA ";
+                writeDuration((m_total-m_current)/m_rate);
+            }
+        }
+        else
+        {
+            m_fmt << " ";
+            writeDuration((uint32_t)(m_lastRedrawTick - m_startTick)/1000u);
+        }
+    }
+
+    //! Значение с SI-суффиксом и одним знаком после точки: 1.5k, 12.0M
+    void writeScaled( uint64_t v )
+    {
+        static const char suffixes[] = { 'k', 'M', 'G', 'T' };
+
+        if (v<1000u)
+        {
+            m_fmt << umba::spec<SimpleFormatter::dec>(v);
+            return;
+        }
+
+        int      idx   = -1;
+        uint64_t tenth = v/100u; // десятые доли тысяч
+        while(tenth>=10000u && idx<2)
+        {
+            tenth /= 1000u;
+            ++idx;
+        }
+        ++idx;
+
+        m_fmt << umba::spec<SimpleFormatter::dec>(tenth/10u) << "." << umba::spec<SimpleFormatter::dec>(tenth%10u);
+        m_fmt.writeBuf(&suffixes[idx], 1);
+    }
+
+    //! Длительность: mm:ss или h:mm:ss
+    void writeDuration( uint64_t seconds )
+    {
+        uint64_t h = seconds/3600u;
+        unsigned m = (unsigned)(seconds/60u%60u);
+        unsigned s = (unsigned)(seconds%60u);
+
+        if (h)
+            m_fmt << umba::spec<SimpleFormatter::dec>(h) << ":";
+        m_fmt << umba::spec<SimpleFormatter::dec, 2, '0'>(m) << ":" << umba::spec<SimpleFormatter::dec, 2, '0'>(s);
+    }
+
+
+    // disable copying
+    ProgressIndicator(const ProgressIndicator&);
+    ProgressIndicator& operator=(const ProgressIndicator&);
+
+
+    SimpleFormatter    &m_fmt;
+    FlushTickSource     m_tickSource;
+
+    uint64_t            m_current          = 0;
+    uint64_t            m_total            = 0;
+    uint32_t            m_checkCountdown   = 1;
+    uint32_t            m_checkStride      = 1;
+
+    uint32_t            m_redrawIntervalMs = 100;
+    uint32_t            m_startTick        = 0;
+    uint32_t            m_lastRedrawTick   = 0;
+    uint32_t            m_lastCheckTick    = 0;
+    uint64_t            m_lastRedrawCount  = 0;
+
+    uint64_t            m_rate             = 0;
+    bool                m_rateValid        = false;
+
+    const char         *m_label            = 0;
+    int                 m_barWidth         = 30;
+    unsigned            m_spinnerPos       = 0;
+
+}; // class ProgressIndicator
+
+
+} // namespace umba
+
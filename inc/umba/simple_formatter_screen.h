@@ -0,0 +1,385 @@
+/*! \file
+\brief Экранный буфер терминала с выводом только изменений между кадрами (только для хоста)
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED)
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Экранный буфер области терминала (статусные экраны, прогресс)
+/*! Кадр рисуется в буфере (print/clear), затем render() сравнивает его с предыдущим выведенным кадром
+    и выводит только измененные участки строк с минимальными перемещениями курсора.
+
+    Для ANSI-терминалов (или при setAnsiOutput(true)) весь кадр - перемещения курсора и текст -
+    формируется в одном буфере и выводится одним вызовом writeBuf. Для прочих терминалов курсор
+    перемещается терминальными методами CharWriterProxy, участки выводятся по одному.
+    Если устройство вывода не терминал, render() ничего не выводит.
+
+    Ячейка хранит один символ Unicode. Широкие символы занимают две ячейки, комбинируемые знаки
+    и управляющие символы не выводятся (заменяются пробелом). Цвета не поддерживаются
+ */
+class TerminalScreenBuffer
+{
+
+public:
+
+    //! width x height - размер области, originX/originY - положение ее левого верхнего угла на экране (от 0)
+    TerminalScreenBuffer( SimpleFormatter &fmt, int width, int height, int originX = 0, int originY = 0 )
+    : m_fmt(fmt)
+    , m_originX(originX)
+    , m_originY(originY)
+    {
+        resize(width, height);
+    }
+
+    int width() const  { return m_width;  }
+    int height() const { return m_height; }
+
+    //! Изменение размера области. Следующий render() перерисует ее целиком
+    void resize( int width, int height )
+    {
+        m_width  = width >0 ? width  : 0;
+        m_height = height>0 ? height : 0;
+        m_back.assign( (std::size_t)m_width*(std::size_t)m_height, (uint32_t)' ' );
+        invalidate();
+    }
+
+    //! Перемещение области на экране. Следующий render() перерисует ее целиком
+    void setOrigin( int originX, int originY )
+    {
+        m_originX = originX;
+        m_originY = originY;
+        invalidate();
+    }
+
+    //! Формировать ANSI-последовательности, даже если устройство вывода не сообщает об ANSI-терминале (например, вывод в канал SSH)
+    void setAnsiOutput( bool forceAnsi )
+    {
+        m_forceAnsi = forceAnsi;
+    }
+
+    //! Содержимое терминала неизвестно (экран очищен, окно изменено) - следующий render() перерисует область целиком
+    void invalidate()
+    {
+        m_front.assign( m_back.size(), (uint32_t)cellUnknown );
+        m_cursorValid = false;
+    }
+
+    //-------------------
+    //! Заполняет кадр пробелами
+    void clear()
+    {
+        std::fill( m_back.begin(), m_back.end(), (uint32_t)' ' );
+    }
+
+    //! Заполняет строку кадра пробелами
+    void clearRow( int y )
+    {
+        if (y<0 || y>=m_height)
+            return;
+        std::fill( m_back.begin() + y*m_width, m_back.begin() + (y+1)*m_width, (uint32_t)' ' );
+    }
+
+    //! Вывод строки UTF-8 в кадр с позиции x, y. Не поместившийся текст отсекается. Возвращает позицию за последним символом
+    int print( int x, int y, const char *str, std::size_t len )
+    {
+        if (y<0 || y>=m_height || !str)
+            return x;
+
+        std::size_t i = 0;
+        while(i!=len && x<m_width)
+        {
+            uint32_t cp;
+            i += format_utils::utf8DecodeChar(str+i, len-i, cp);
+
+            int w = format_utils::unicodeCharWidth(cp);
+            if (cp<0x20 || cp==0x7F || (cp>=0x80 && cp<0xA0))
+                cp = (uint32_t)' ';
+            else if (w==0)
+                continue;
+
+            if (w==2 && x+1>=m_width)
+                break;
+
+            if (x>=0)
+                putCell(x, y, cp, w);
+            x += w;
+        }
+
+        return x;
+    }
+
+    int print( int x, int y, const char *str )
+    {
+        return print(x, y, str, str ? std::strlen(str) : 0);
+    }
+
+    int print( int x, int y, const std::string &str )
+    {
+        return print(x, y, str.data(), str.size());
+    }
+
+    //-------------------
+    //! Выводит изменения кадра относительно предыдущего выведенного. Возвращает false, если вывод не выполнялся
+    /*! Положение курсора между кадрами не считается известным (между ними мог быть другой вывод, например,
+        строки лога), поэтому первое перемещение кадра - абсолютное (CUP). Если другой вывод изменил
+        содержимое области, нужно вызвать invalidate()
+     */
+    bool render()
+    {
+        if (!m_fmt.isOutputEnabled() || !m_width || !m_height)
+            return false;
+
+        ICharWriter *pWriter = m_fmt.getCharWritter();
+        bool ansi = m_forceAnsi || pWriter->isAnsiTerminal();
+        if (!ansi && !pWriter->isTerminal())
+            return false;
+
+        m_out.clear();
+        m_cursorValid = false;
+
+        for(int y=0; y!=m_height; ++y)
+            renderRow(y, ansi);
+
+        if (ansi && !m_out.empty())
+            m_fmt.writeBuf(&m_out[0], m_out.size());
+
+        m_front = m_back;
+        m_fmt.flush();
+
+        return true;
+    }
+
+    //! Объем последнего вывода render() в байтах (для ANSI-вывода)
+    std::size_t lastFrameBytes() const
+    {
+        return m_out.size();
+    }
+
+
+protected:
+
+    //! Вторая половина широкого символа
+    static const uint32_t cellWideTail = 0xFFFFFFFFu;
+    //! Содержимое ячейки терминала неизвестно
+    static const uint32_t cellUnknown  = 0xFFFFFFFEu;
+
+    //-------------------
+    uint32_t& backCell( int x, int y )
+    {
+        return m_back[(std::size_t)y*(std::size_t)m_width + (std::size_t)x];
+    }
+
+    //! Запись символа в кадр, с удалением половинок широких символов, которые он перекрывает
+    void putCell( int x, int y, uint32_t cp, int w )
+    {
+        if (backCell(x, y)==cellWideTail && x>0)
+            backCell(x-1, y) = (uint32_t)' ';
+
+        int xEnd = x + w;
+        if (xEnd<m_width && backCell(xEnd, y)==cellWideTail)
+            backCell(xEnd, y) = (uint32_t)' ';
+
+        backCell(x, y) = cp;
+        if (w==2)
+            backCell(x+1, y) = cellWideTail;
+    }
+
+    //-------------------
+    void renderRow( int y, bool ansi )
+    {
+        const uint32_t *pBack  = &m_back [(std::size_t)y*(std::size_t)m_width];
+        const uint32_t *pFront = &m_front[(std::size_t)y*(std::size_t)m_width];
+
+        int x = 0;
+        int pendingX = -1; // конец последнего выведенного участка строки - для решения, переписать промежуток или переместить курсор
+
+        while(x!=m_width)
+        {
+            if (pBack[x]==pFront[x])
+            {
+                ++x;
+                continue;
+            }
+
+            // Начало измененного участка. Участок не должен начинаться со второй половины широкого символа
+            int spanBegin = x;
+            if (spanBegin>0 && (pBack[spanBegin]==cellWideTail || pFront[spanBegin]==cellWideTail))
+                --spanBegin;
+
+            int spanEnd = x+1;
+            while(spanEnd!=m_width && pBack[spanEnd]!=pFront[spanEnd])
+                ++spanEnd;
+            if (spanEnd!=m_width && pBack[spanEnd]==cellWideTail)
+                ++spanEnd;
+
+            // Короткий промежуток без изменений дешевле переписать, чем перемещать курсор
+            if (pendingX>=0 && spanBegin>=pendingX && cellsBytes(pBack, pendingX, spanBegin) <= moveCost(m_originX+spanBegin, m_originY+y))
+                spanBegin = pendingX;
+            else
+                moveCursor(m_originX+spanBegin, m_originY+y, ansi);
+
+            writeCells(pBack, spanBegin, spanEnd, ansi);
+
+            m_cursorX = m_originX + spanEnd;
+            m_cursorY = m_originY + y;
+            // После вывода в последнюю колонку терминал может находиться в состоянии отложенного переноса
+            m_cursorValid = spanEnd!=m_width;
+
+            pendingX = spanEnd;
+            x        = spanEnd;
+        }
+    }
+
+    //-------------------
+    static std::size_t cellBytes( uint32_t cp )
+    {
+        return cp==cellWideTail ? 0 : format_utils::utf8CharLen(cp>0x10FFFF ? (uint32_t)' ' : cp);
+    }
+
+    static std::size_t cellsBytes( const uint32_t *pCells, int xBegin, int xEnd )
+    {
+        std::size_t res = 0;
+        for(int x=xBegin; x!=xEnd; ++x)
+            res += cellBytes(pCells[x]);
+        return res;
+    }
+
+    void writeCells( const uint32_t *pCells, int xBegin, int xEnd, bool ansi )
+    {
+        char buf[256];
+        std::size_t pos = 0;
+
+        for(int x=xBegin; x!=xEnd; ++x)
+        {
+            uint32_t cp = pCells[x];
+            if (cp==cellWideTail)
+                continue;
+            if (cp>0x10FFFF)
+                cp = (uint32_t)' ';
+
+            if (sizeof(buf)-pos<4)
+            {
+                emit(&buf[0], pos, ansi);
+                pos = 0;
+            }
+            pos += format_utils::utf8EncodeChar(cp, &buf[pos]);
+        }
+
+        emit(&buf[0], pos, ansi);
+    }
+
+    void emit( const char *p, std::size_t len, bool ansi )
+    {
+        if (!len)
+            return;
+        if (ansi)
+            m_out.insert(m_out.end(), p, p+len);
+        else
+            m_fmt.writeBuf(p, len);
+    }
+
+    //-------------------
+    static std::size_t decLen( int n )
+    {
+        std::size_t res = 1;
+        for(; n>=10; n/=10)
+            ++res;
+        return res;
+    }
+
+    //! Длина кратчайшей ANSI-последовательности перемещения курсора в screenX, screenY (0 - курсор уже там)
+    std::size_t moveCost( int screenX, int screenY ) const
+    {
+        if (m_cursorValid && screenY==m_cursorY)
+        {
+            if (screenX==m_cursorX)
+                return 0;
+            std::size_t cha = 3 + decLen(screenX+1);                // ESC [ col G
+            if (screenX>m_cursorX)
+            {
+                std::size_t cuf = 3 + decLen(screenX-m_cursorX);  // ESC [ n C
+                return cuf<cha ? cuf : cha;
+            }
+            return cha;
+        }
+        return 4 + decLen(screenY+1) + decLen(screenX+1);         // ESC [ row ; col H
+    }
+
+    void appendCsi( int n1, int n2, char cmd )
+    {
+        char buf[32];
+        int  len = 0;
+        if (n2<0)
+            len = std::snprintf(&buf[0], sizeof(buf), "\x1b[%d%c", n1, cmd);
+        else
+            len = std::snprintf(&buf[0], sizeof(buf), "\x1b[%d;%d%c", n1, n2, cmd);
+        if (len>0)
+            m_out.insert(m_out.end(), &buf[0], &buf[0]+len);
+    }
+
+    void moveCursor( int screenX, int screenY, bool ansi )
+    {
+        if (m_cursorValid && screenX==m_cursorX && screenY==m_cursorY)
+            return;
+
+        if (!ansi)
+        {
+            m_fmt.getCharWritter()->terminalMoveToAbsPos(screenX, screenY);
+            return;
+        }
+
+        if (m_cursorValid && screenY==m_cursorY)
+        {
+            std::size_t cha = 3 + decLen(screenX+1);
+            if (screenX>m_cursorX && 3 + decLen(screenX-m_cursorX) < cha)
+                appendCsi(screenX-m_cursorX, -1, 'C');
+            else
+                appendCsi(screenX+1, -1, 'G');
+            return;
+        }
+
+        appendCsi(screenY+1, screenX+1, 'H');
+    }
+
+
+    // disable copying
+    TerminalScreenBuffer(const TerminalScreenBuffer&);
+    TerminalScreenBuffer& operator=(const TerminalScreenBuffer&);
+
+
+    SimpleFormatter        &m_fmt;
+    int                     m_width       = 0;
+    int                     m_height      = 0;
+    int                     m_originX     = 0;
+    int                     m_originY     = 0;
+    bool                    m_forceAnsi   = false;
+
+    std::vector<uint32_t>   m_back;   //!< формируемый кадр
+    std::vector<uint32_t>   m_front;  //!< кадр, выведенный на терминал
+    std::vector<char>       m_out;    //!< ANSI-вывод кадра
+
+    int                     m_cursorX     = 0;
+    int                     m_cursorY     = 0;
+    bool                    m_cursorValid = false;
+
+}; // class TerminalScreenBuffer
+
+
+} // namespace umba
+
+#endif // !UMBA_MCU_USED
+
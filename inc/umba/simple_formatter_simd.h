@@ -0,0 +1,698 @@
+/*! \file
+\brief SIMD-ядра для SimpleFormatter с выбором реализации во время выполнения по возможностям CPU
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+#if !defined(UMBA_MCU_USED) && !defined(UMBA_SIMPLE_FORMATTER_NO_SIMD)
+
+    #if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+        #define UMBA_SIMPLE_FORMATTER_SIMD_X86
+    #endif
+
+#endif
+
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #include <immintrin.h>
+        // MSVC позволяет использовать интринсики без ключей компилятора
+        #define UMBA_SIMPLE_FORMATTER_SIMD_TARGET_SSE41
+        #define UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+    #else
+        #include <immintrin.h>
+        // GCC/Clang - код под SSE4.1/AVX2 генерируется только для помеченных функций, остальной код собирается под базовую архитектуру
+        #define UMBA_SIMPLE_FORMATTER_SIMD_TARGET_SSE41   __attribute__((target("sse4.1")))
+        #define UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2    __attribute__((target("avx2")))
+    #endif
+
+#endif
+
+
+
+namespace umba
+{
+
+namespace format_utils
+{
+
+namespace simd
+{
+
+static const unsigned cpuFeatureSse41 = 0x0001;
+static const unsigned cpuFeatureAvx2  = 0x0002;
+
+//-----------------------------------------------------------------------------
+inline
+unsigned detectCpuFeatures()
+{
+    unsigned res = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    #if defined(_MSC_VER) && !defined(__clang__)
+
+        int regs[4] = { 0 };
+        __cpuid(regs, 0);
+        int maxLeaf = regs[0];
+
+        if (maxLeaf>=1)
+        {
+            __cpuid(regs, 1);
+            if (regs[2] & (1<<19))
+                res |= cpuFeatureSse41;
+
+            // AVX2 требует поддержки сохранения YMM регистров со стороны OS (OSXSAVE + XCR0)
+            bool osAvx = (regs[2] & (1<<27)) && (regs[2] & (1<<28)) && ((_xgetbv(0) & 0x6)==0x6);
+            if (osAvx && maxLeaf>=7)
+            {
+                __cpuidex(regs, 7, 0);
+                if (regs[1] & (1<<5))
+                    res |= cpuFeatureAvx2;
+            }
+        }
+
+    #else
+
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.1"))
+            res |= cpuFeatureSse41;
+        if (__builtin_cpu_supports("avx2"))
+            res |= cpuFeatureAvx2;
+
+    #endif
+
+#endif
+
+    return res;
+}
+
+//-----------------------------------------------------------------------------
+//! Возможности CPU определяются однократно, при первом вызове
+inline
+unsigned getCpuFeatures()
+{
+    static const unsigned features = detectCpuFeatures();
+    return features;
+}
+
+//-----------------------------------------------------------------------------
+//! Скалярная версия - 10 десятичных цифр (с ведущими нулями) одного числа
+inline
+void formatUInt32Dec10Scalar( uint32_t val, char *pDigits )
+{
+    for(int i=9; i>=0; --i)
+    {
+        pDigits[i] = (char)('0' + val%10u);
+        val /= 10u;
+    }
+}
+
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+/*
+    Число v (32 бита) разбивается на hi = v / 10^8 (не более двух цифр) и lo = v % 10^8,
+    lo - на две четырехзначные группы a = lo / 10^4 и b = lo % 10^4.
+    Деление на константу выполняется умножением на обратную величину:
+        v / 10^8  = (v  * 1441151881) >> 57   - точно для любых v < 2^32
+        lo / 10^4 = (lo * 109951163)  >> 40   - точно для любых lo < 2^27
+    Четырехзначные группы разбираются на цифры в 16ти-битных лейнах:
+        n / 100   = (n * 5243) >> 19          - точно для n < 10000
+        n / 10    = (n * 6554) >> 16          - точно для n < 100
+ */
+
+//-----------------------------------------------------------------------------
+//! SSE4.1 - 4 числа за раз, по 10 цифр на число
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_SSE41
+inline
+void formatUInt32Dec10Sse41( const uint32_t *pVals, char *pDigits )
+{
+    const __m128i v   = _mm_loadu_si128((const __m128i*)pVals);
+
+    const __m128i m8  = _mm_set1_epi32(1441151881);
+    __m128i evn       = _mm_srli_epi64(_mm_mul_epu32(v, m8), 57);
+    __m128i odd       = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(v, 32), m8), 57);
+    const __m128i hi  = _mm_blend_epi16(evn, _mm_slli_epi64(odd, 32), 0xCC);
+    const __m128i lo  = _mm_sub_epi32(v, _mm_mullo_epi32(hi, _mm_set1_epi32(100000000)));
+
+    const __m128i m4  = _mm_set1_epi32(109951163);
+    evn               = _mm_srli_epi64(_mm_mul_epu32(lo, m4), 40);
+    odd               = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(lo, 32), m4), 40);
+    const __m128i a   = _mm_blend_epi16(evn, _mm_slli_epi64(odd, 32), 0xCC);
+    const __m128i b   = _mm_sub_epi32(lo, _mm_mullo_epi32(a, _mm_set1_epi32(10000)));
+
+    // a0..a3, b0..b3 - 16ти-битные лейны
+    const __m128i n   = _mm_packus_epi32(a, b);
+    const __m128i q   = _mm_srli_epi16(_mm_mulhi_epu16(n, _mm_set1_epi16(5243)), 3);
+    const __m128i r   = _mm_sub_epi16(n, _mm_mullo_epi16(q, _mm_set1_epi16(100)));
+
+    const __m128i m10 = _mm_set1_epi16(6554);
+    const __m128i ten = _mm_set1_epi16(10);
+    const __m128i qt  = _mm_mulhi_epu16(q, m10);
+    const __m128i qo  = _mm_sub_epi16(q, _mm_mullo_epi16(qt, ten));
+    const __m128i rt  = _mm_mulhi_epu16(r, m10);
+    const __m128i ro  = _mm_sub_epi16(r, _mm_mullo_epi16(rt, ten));
+
+    const __m128i ascii    = _mm_set1_epi8('0');
+    const __m128i lowPair  = _mm_or_si128(qt, _mm_slli_epi16(qo, 8));
+    const __m128i highPair = _mm_or_si128(rt, _mm_slli_epi16(ro, 8));
+    const __m128i wa       = _mm_add_epi8(_mm_unpacklo_epi16(lowPair, highPair), ascii);
+    const __m128i wb       = _mm_add_epi8(_mm_unpackhi_epi16(lowPair, highPair), ascii);
+
+    const __m128i ht  = _mm_srli_epi32(_mm_mullo_epi32(hi, _mm_set1_epi32(6554)), 16);
+    const __m128i ho  = _mm_sub_epi32(hi, _mm_mullo_epi32(ht, _mm_set1_epi32(10)));
+    const __m128i wh  = _mm_add_epi8(_mm_or_si128(ht, _mm_slli_epi32(ho, 8)), ascii);
+
+    uint32_t hiW[4], aW[4], bW[4];
+    _mm_storeu_si128((__m128i*)hiW, wh);
+    _mm_storeu_si128((__m128i*)aW , wa);
+    _mm_storeu_si128((__m128i*)bW , wb);
+
+    for(unsigned i=0; i!=4; ++i, pDigits+=10)
+    {
+        std::memcpy(pDigits  , &hiW[i], 2);
+        std::memcpy(pDigits+2, &aW[i] , 4);
+        std::memcpy(pDigits+6, &bW[i] , 4);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//! AVX2 - 8 чисел за раз, по 10 цифр на число. Алгоритм тот же, что и для SSE4.1
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+inline
+void formatUInt32Dec10Avx2( const uint32_t *pVals, char *pDigits )
+{
+    const __m256i v   = _mm256_loadu_si256((const __m256i*)pVals);
+
+    const __m256i m8  = _mm256_set1_epi32(1441151881);
+    __m256i evn       = _mm256_srli_epi64(_mm256_mul_epu32(v, m8), 57);
+    __m256i odd       = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v, 32), m8), 57);
+    const __m256i hi  = _mm256_blend_epi16(evn, _mm256_slli_epi64(odd, 32), 0xCC);
+    const __m256i lo  = _mm256_sub_epi32(v, _mm256_mullo_epi32(hi, _mm256_set1_epi32(100000000)));
+
+    const __m256i m4  = _mm256_set1_epi32(109951163);
+    evn               = _mm256_srli_epi64(_mm256_mul_epu32(lo, m4), 40);
+    odd               = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(lo, 32), m4), 40);
+    const __m256i a   = _mm256_blend_epi16(evn, _mm256_slli_epi64(odd, 32), 0xCC);
+    const __m256i b   = _mm256_sub_epi32(lo, _mm256_mullo_epi32(a, _mm256_set1_epi32(10000)));
+
+    // packus/unpack работают внутри 128ми-битных половин, поэтому
+    // unpacklo дает группы a0..a7, а unpackhi - b0..b7, уже в исходном порядке
+    const __m256i n   = _mm256_packus_epi32(a, b);
+    const __m256i q   = _mm256_srli_epi16(_mm256_mulhi_epu16(n, _mm256_set1_epi16(5243)), 3);
+    const __m256i r   = _mm256_sub_epi16(n, _mm256_mullo_epi16(q, _mm256_set1_epi16(100)));
+
+    const __m256i m10 = _mm256_set1_epi16(6554);
+    const __m256i ten = _mm256_set1_epi16(10);
+    const __m256i qt  = _mm256_mulhi_epu16(q, m10);
+    const __m256i qo  = _mm256_sub_epi16(q, _mm256_mullo_epi16(qt, ten));
+    const __m256i rt  = _mm256_mulhi_epu16(r, m10);
+    const __m256i ro  = _mm256_sub_epi16(r, _mm256_mullo_epi16(rt, ten));
+
+    const __m256i ascii    = _mm256_set1_epi8('0');
+    const __m256i lowPair  = _mm256_or_si256(qt, _mm256_slli_epi16(qo, 8));
+    const __m256i highPair = _mm256_or_si256(rt, _mm256_slli_epi16(ro, 8));
+    const __m256i wa       = _mm256_add_epi8(_mm256_unpacklo_epi16(lowPair, highPair), ascii);
+    const __m256i wb       = _mm256_add_epi8(_mm256_unpackhi_epi16(lowPair, highPair), ascii);
+
+    const __m256i ht  = _mm256_srli_epi32(_mm256_mullo_epi32(hi, _mm256_set1_epi32(6554)), 16);
+    const __m256i ho  = _mm256_sub_epi32(hi, _mm256_mullo_epi32(ht, _mm256_set1_epi32(10)));
+    const __m256i wh  = _mm256_add_epi8(_mm256_or_si256(ht, _mm256_slli_epi32(ho, 8)), ascii);
+
+    uint32_t hiW[8], aW[8], bW[8];
+    _mm256_storeu_si256((__m256i*)hiW, wh);
+    _mm256_storeu_si256((__m256i*)aW , wa);
+    _mm256_storeu_si256((__m256i*)bW , wb);
+
+    for(unsigned i=0; i!=8; ++i, pDigits+=10)
+    {
+        std::memcpy(pDigits  , &hiW[i], 2);
+        std::memcpy(pDigits+2, &aW[i] , 4);
+        std::memcpy(pDigits+6, &bW[i] , 4);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//! Номер младшего установленного бита (mask!=0)
+inline
+unsigned countTrailingZeros32( uint32_t mask )
+{
+    #if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return (unsigned)idx;
+    #else
+        return (unsigned)__builtin_ctz(mask);
+    #endif
+}
+
+/*
+    Поиск символов, требующих экранирования в JSON: '"', '\\' и управляющих (< 0x20).
+    Беззнаковое сравнение c <= 0x1F выполняется как max(c, 0x1F)==0x1F.
+    SSE2 входит в базовую архитектуру x86_64, поэтому SSE2-версия не требует проверки CPU
+ */
+
+//-----------------------------------------------------------------------------
+inline
+uint32_t jsonSpecialMaskSse2( __m128i v )
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctrl  = _mm_set1_epi8(0x1F);
+
+    __m128i m = _mm_or_si128( _mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash) );
+    m = _mm_or_si128( m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl) );
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+//-----------------------------------------------------------------------------
+//! SSE2 - 16 байт за раз. Возвращает индекс первого спецсимвола или len
+inline
+std::size_t findJsonSpecialSse2( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        uint32_t mask = jsonSpecialMaskSse2( _mm_loadu_si128((const __m128i*)(p+i)) );
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! AVX2 - 32 байта за раз
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+inline
+std::size_t findJsonSpecialAvx2( const char *p, std::size_t len )
+{
+    const __m256i quote  = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i ctrl   = _mm256_set1_epi8(0x1F);
+
+    std::size_t i = 0;
+    for(; i+32<=len; i+=32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p+i));
+        __m256i m = _mm256_or_si256( _mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash) );
+        m = _mm256_or_si256( m, _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrl), ctrl) );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+/*
+    Поиск символов, требующих экранирования в стиле C: все, кроме печатных ASCII 0x20..0x7E, а также '\\' и '"'.
+    Знаковое сравнение c < 0x20 отбирает и управляющие символы, и байты >= 0x80 (отрицательные как int8)
+ */
+
+//-----------------------------------------------------------------------------
+//! SSE2 - 16 байт за раз. Возвращает индекс первого непечатного символа или len (с точностью до хвоста < 16 байт)
+inline
+std::size_t findCEscapeCharSse2( const char *p, std::size_t len )
+{
+    const __m128i space  = _mm_set1_epi8(0x20);
+    const __m128i del    = _mm_set1_epi8(0x7F);
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i quote  = _mm_set1_epi8('"');
+
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p+i));
+        __m128i m = _mm_or_si128( _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del))
+                                , _mm_or_si128(_mm_cmpeq_epi8(v, bslash), _mm_cmpeq_epi8(v, quote))
+                                );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! AVX2 - 32 байта за раз
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+inline
+std::size_t findCEscapeCharAvx2( const char *p, std::size_t len )
+{
+    const __m256i space  = _mm256_set1_epi8(0x20);
+    const __m256i del    = _mm256_set1_epi8(0x7F);
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i quote  = _mm256_set1_epi8('"');
+
+    std::size_t i = 0;
+    for(; i+32<=len; i+=32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p+i));
+        __m256i m = _mm256_or_si256( _mm256_or_si256(_mm256_cmpgt_epi8(space, v), _mm256_cmpeq_epi8(v, del))
+                                   , _mm256_or_si256(_mm256_cmpeq_epi8(v, bslash), _mm256_cmpeq_epi8(v, quote))
+                                   );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Поиск любого из четырех символов, SSE2 - 16 байт за раз. Возвращает индекс первого найденного или len (с точностью до хвоста < 16 байт)
+inline
+std::size_t findAnyOf4Sse2( const char *p, std::size_t len, char c0, char c1, char c2, char c3 )
+{
+    const __m128i v0 = _mm_set1_epi8(c0);
+    const __m128i v1 = _mm_set1_epi8(c1);
+    const __m128i v2 = _mm_set1_epi8(c2);
+    const __m128i v3 = _mm_set1_epi8(c3);
+
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p+i));
+        __m128i m = _mm_or_si128( _mm_or_si128(_mm_cmpeq_epi8(v, v0), _mm_cmpeq_epi8(v, v1))
+                                , _mm_or_si128(_mm_cmpeq_epi8(v, v2), _mm_cmpeq_epi8(v, v3))
+                                );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Поиск любого из четырех символов, AVX2 - 32 байта за раз
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+inline
+std::size_t findAnyOf4Avx2( const char *p, std::size_t len, char c0, char c1, char c2, char c3 )
+{
+    const __m256i v0 = _mm256_set1_epi8(c0);
+    const __m256i v1 = _mm256_set1_epi8(c1);
+    const __m256i v2 = _mm256_set1_epi8(c2);
+    const __m256i v3 = _mm256_set1_epi8(c3);
+
+    std::size_t i = 0;
+    for(; i+32<=len; i+=32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p+i));
+        __m256i m = _mm256_or_si256( _mm256_or_si256(_mm256_cmpeq_epi8(v, v0), _mm256_cmpeq_epi8(v, v1))
+                                   , _mm256_or_si256(_mm256_cmpeq_epi8(v, v2), _mm256_cmpeq_epi8(v, v3))
+                                   );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Поиск байта >= 0x80 (не ASCII), SSE2 - 16 байт за раз: старший бит байта и есть результат movemask
+inline
+std::size_t findNonAsciiSse2( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        uint32_t mask = (uint32_t)_mm_movemask_epi8( _mm_loadu_si128((const __m128i*)(p+i)) );
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Поиск байта >= 0x80, AVX2 - 32 байта за раз
+UMBA_SIMPLE_FORMATTER_SIMD_TARGET_AVX2
+inline
+std::size_t findNonAsciiAvx2( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+    for(; i+32<=len; i+=32)
+    {
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8( _mm256_loadu_si256((const __m256i*)(p+i)) );
+        if (mask)
+            return i + countTrailingZeros32(mask);
+    }
+    return i;
+}
+
+/*
+    Сужение ASCII-участков строк UTF-16/UTF-32 до байт. Блок ASCII, если (u & ~0x7F)==0 для всех единиц,
+    упаковка - packs/packus с насыщением, для значений < 0x80 это просто отбрасывание старших байт
+ */
+
+//-----------------------------------------------------------------------------
+//! UTF-16, SSE2 - 16 единиц за раз. Копирует в pDst начальный ASCII-участок (кратно 16), возвращает количество скопированных единиц
+inline
+std::size_t copyAscii16Sse2( const char16_t *p, std::size_t len, char *pDst )
+{
+    const __m128i hiMask = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero   = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(p+i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(p+i+8));
+        __m128i hi = _mm_and_si128(_mm_or_si128(v0, v1), hiMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, zero))!=0xFFFF)
+            break;
+        _mm_storeu_si128((__m128i*)(pDst+i), _mm_packus_epi16(v0, v1));
+    }
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! UTF-32, SSE2 - 16 единиц за раз
+inline
+std::size_t copyAscii32Sse2( const char32_t *p, std::size_t len, char *pDst )
+{
+    const __m128i hiMask = _mm_set1_epi32((int)0xFFFFFF80);
+    const __m128i zero   = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for(; i+16<=len; i+=16)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(p+i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(p+i+4));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(p+i+8));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(p+i+12));
+        __m128i hi = _mm_and_si128(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3)), hiMask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(hi, zero))!=0xFFFF)
+            break;
+        __m128i w0 = _mm_packs_epi32(v0, v1);
+        __m128i w1 = _mm_packs_epi32(v2, v3);
+        _mm_storeu_si128((__m128i*)(pDst+i), _mm_packus_epi16(w0, w1));
+    }
+    return i;
+}
+
+#endif // UMBA_SIMPLE_FORMATTER_SIMD_X86
+
+
+} // namespace simd
+
+
+//-----------------------------------------------------------------------------
+//! Форматирует count чисел в десятичном виде, ровно по 10 цифр (с ведущими нулями) на число. Результат не зависит от выбранной реализации
+inline
+void formatUInt32DecFixed( const uint32_t *pVals, std::size_t count, char *pDigits )
+{
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    unsigned features = simd::getCpuFeatures();
+
+    if (features & simd::cpuFeatureAvx2)
+    {
+        for(; count>=8; count-=8, pVals+=8, pDigits+=80)
+            simd::formatUInt32Dec10Avx2(pVals, pDigits);
+    }
+
+    if (features & simd::cpuFeatureSse41)
+    {
+        for(; count>=4; count-=4, pVals+=4, pDigits+=40)
+            simd::formatUInt32Dec10Sse41(pVals, pDigits);
+    }
+
+#endif
+
+    for(; count; --count, ++pVals, pDigits+=10)
+        simd::formatUInt32Dec10Scalar(*pVals, pDigits);
+}
+
+//-----------------------------------------------------------------------------
+//! Символ требует экранирования в строке JSON
+inline
+bool isJsonSpecialChar( char ch )
+{
+    return ch=='"' || ch=='\\' || (unsigned char)ch<0x20;
+}
+
+//-----------------------------------------------------------------------------
+//! Длина начального участка строки, не требующего экранирования в JSON (индекс первого спецсимвола или len)
+inline
+std::size_t findJsonSpecialChar( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    if (simd::getCpuFeatures() & simd::cpuFeatureAvx2)
+    {
+        i = simd::findJsonSpecialAvx2(p, len);
+        if (i!=len && isJsonSpecialChar(p[i]))
+            return i;
+    }
+
+    i += simd::findJsonSpecialSse2(p+i, len-i);
+    if (i!=len && isJsonSpecialChar(p[i]))
+        return i;
+
+#endif
+
+    for(; i!=len; ++i)
+    {
+        if (isJsonSpecialChar(p[i]))
+            break;
+    }
+
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Символ требует экранирования в стиле C (не печатный ASCII, '\\' или '"')
+inline
+bool isCEscapeChar( char ch )
+{
+    unsigned char c = (unsigned char)ch;
+    return c<0x20 || c>=0x7F || c=='\\' || c=='"';
+}
+
+//-----------------------------------------------------------------------------
+//! Длина начального участка строки из печатных ASCII символов, не требующих экранирования в стиле C
+inline
+std::size_t findCEscapeChar( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    if (simd::getCpuFeatures() & simd::cpuFeatureAvx2)
+        i = simd::findCEscapeCharAvx2(p, len);
+
+    if (len-i>=16)
+        i += simd::findCEscapeCharSse2(p+i, len-i);
+
+#endif
+
+    for(; i!=len; ++i)
+    {
+        if (isCEscapeChar(p[i]))
+            break;
+    }
+
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Индекс первого из символов c0..c3 в строке или len (например, спецсимволы CSV - разделитель, кавычка, CR, LF)
+inline
+std::size_t findAnyOf4( const char *p, std::size_t len, char c0, char c1, char c2, char c3 )
+{
+    std::size_t i = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    if (simd::getCpuFeatures() & simd::cpuFeatureAvx2)
+        i = simd::findAnyOf4Avx2(p, len, c0, c1, c2, c3);
+
+    if (len-i>=16)
+        i += simd::findAnyOf4Sse2(p+i, len-i, c0, c1, c2, c3);
+
+#endif
+
+    for(; i!=len; ++i)
+    {
+        char ch = p[i];
+        if (ch==c0 || ch==c1 || ch==c2 || ch==c3)
+            break;
+    }
+
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Длина начального участка строки из ASCII символов (индекс первого байта >= 0x80 или len)
+inline
+std::size_t findNonAscii( const char *p, std::size_t len )
+{
+    std::size_t i = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+
+    if (simd::getCpuFeatures() & simd::cpuFeatureAvx2)
+        i = simd::findNonAsciiAvx2(p, len);
+
+    if (len-i>=16)
+        i += simd::findNonAsciiSse2(p+i, len-i);
+
+#endif
+
+    for(; i!=len; ++i)
+    {
+        if ((unsigned char)p[i]>=0x80)
+            break;
+    }
+
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Копирует в pDst начальный ASCII-участок строки из 16ти- или 32х-битных единиц (не более len единиц), возвращает его длину
+/*! CharT - char16_t, char32_t или wchar_t. SIMD-ядро выбирается по размеру единицы
+ */
+template<typename CharT>
+std::size_t copyAsciiPrefix( const CharT *p, std::size_t len, char *pDst )
+{
+    std::size_t i = 0;
+
+#if defined(UMBA_SIMPLE_FORMATTER_SIMD_X86)
+    if (sizeof(CharT)==2)
+        i = simd::copyAscii16Sse2((const char16_t*)p, len, pDst);
+    else if (sizeof(CharT)==4)
+        i = simd::copyAscii32Sse2((const char32_t*)p, len, pDst);
+#endif
+
+    for(; i!=len && (uint32_t)p[i]<0x80; ++i)
+        pDst[i] = (char)p[i];
+
+    return i;
+}
+
+//-----------------------------------------------------------------------------
+//! Количество десятичных цифр числа (для нуля - 1)
+inline
+int countUInt32DecDigits( uint32_t val )
+{
+    static const uint32_t pows[] = { 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u };
+
+    int n = 1;
+    while(n!=10 && val>=pows[n-1])
+        ++n;
+
+    return n;
+}
+
+
+} // namespace format_utils
+
+} // namespace umba
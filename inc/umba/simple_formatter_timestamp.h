@@ -0,0 +1,234 @@
+/*! \file
+\brief Кешированная метка времени для строк лога (только для хоста)
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED)
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Формат метки времени CachedTimestamp
+enum class TimestampFormat
+{
+    iso8601,        //!< Локальное время, микросекунды: 2024-05-01T12:34:56.123456
+    iso8601Millis,  //!< Локальное время, миллисекунды: 2024-05-01T12:34:56.123
+    iso8601Utc,     //!< UTC, микросекунды: 2024-05-01T09:34:56.123456Z
+    epochMicros     //!< Микросекунды от начала эпохи Unix: 1714556096123456
+};
+
+
+//-----------------------------------------------------------------------------
+//! Метка времени с кешированием текста секунды
+/*! Текст даты/времени формируется (localtime/gmtime + форматирование) только при смене секунды,
+    в остальных вызовах в готовом буфере заменяются только цифры долей секунды.
+
+    Время берется из монотонных часов (std::chrono::steady_clock) относительно точки синхронизации
+    с системными часами; синхронизация повторяется раз в resyncSeconds секунд, чтобы учитывать
+    коррекцию системного времени. Выдаваемое время не убывает.
+
+    Объект не потокобезопасен - нужен отдельный экземпляр на поток/форматтер
+ */
+class CachedTimestamp
+{
+
+public:
+
+    CachedTimestamp( TimestampFormat fmt = TimestampFormat::iso8601, unsigned resyncSeconds = 60 )
+    : m_format(fmt)
+    , m_resyncInterval( std::chrono::seconds(resyncSeconds) )
+    {
+        resync();
+    }
+
+    TimestampFormat getFormat() const
+    {
+        return m_format;
+    }
+
+    void setFormat( TimestampFormat fmt )
+    {
+        m_format       = fmt;
+        m_cachedSecond = invalidSecond;
+    }
+
+    //! Синхронизация с системными часами
+    void resync()
+    {
+        m_syncSteady  = steady_clock::now();
+        m_syncWallUs  = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    //! Текущее время в микросекундах от начала эпохи
+    int64_t nowMicros()
+    {
+        steady_clock::time_point now = steady_clock::now();
+        if (now - m_syncSteady >= m_resyncInterval)
+        {
+            resync();
+            now = m_syncSteady;
+        }
+
+        int64_t us = m_syncWallUs + (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - m_syncSteady).count();
+
+        // При синхронизации системное время могло сдвинуться назад
+        if (us < m_lastUs)
+            us = m_lastUs;
+        m_lastUs = us;
+
+        return us;
+    }
+
+    //! Обновляет метку до текущего времени и возвращает ASCII-Z строку
+    const char* c_str()
+    {
+        update(nowMicros());
+        return &m_buf[0];
+    }
+
+    //! Длина метки, сформированной последним вызовом c_str()
+    std::size_t size() const
+    {
+        return m_len;
+    }
+
+
+protected:
+
+    typedef std::chrono::steady_clock steady_clock;
+
+    static const int64_t invalidSecond = INT64_MIN;
+
+    //-------------------
+    void update( int64_t us )
+    {
+        int64_t sec  = us / 1000000;
+        int64_t frac = us % 1000000;
+        if (frac<0)
+        {
+            frac += 1000000;
+            sec  -= 1;
+        }
+
+        if (sec!=m_cachedSecond)
+        {
+            renderSecond(sec);
+            m_cachedSecond = sec;
+        }
+
+        // Доли секунды - единственное, что меняется внутри секунды
+        int numDigits = 6;
+        if (m_format==TimestampFormat::iso8601Millis)
+        {
+            numDigits = 3;
+            frac /= 1000;
+        }
+
+        char *p = &m_buf[m_fracPos + (std::size_t)numDigits];
+        for(int i=0; i!=numDigits; ++i)
+        {
+            *--p = (char)('0' + (int)(frac%10));
+            frac /= 10;
+        }
+    }
+
+    //-------------------
+    void renderSecond( int64_t sec )
+    {
+        int n = 0;
+
+        if (m_format==TimestampFormat::epochMicros)
+        {
+            n = std::snprintf(&m_buf[0], sizeof(m_buf), "%lld", (long long)sec);
+            m_fracPos = (std::size_t)n;
+            n += 6;
+        }
+        else
+        {
+            std::time_t t = (std::time_t)sec;
+            std::tm     tmv;
+
+            bool utc = m_format==TimestampFormat::iso8601Utc;
+
+            #if defined(_MSC_VER)
+                if (utc) gmtime_s(&tmv, &t); else localtime_s(&tmv, &t);
+            #else
+                if (utc) gmtime_r(&t, &tmv); else localtime_r(&t, &tmv);
+            #endif
+
+            n = std::snprintf( &m_buf[0], sizeof(m_buf), "%04d-%02d-%02dT%02d:%02d:%02d."
+                             , tmv.tm_year+1900, tmv.tm_mon+1, tmv.tm_mday
+                             , tmv.tm_hour, tmv.tm_min, tmv.tm_sec
+                             );
+            m_fracPos = (std::size_t)n;
+            n += m_format==TimestampFormat::iso8601Millis ? 3 : 6;
+
+            if (utc)
+                m_buf[n++] = 'Z';
+        }
+
+        m_buf[n] = 0;
+        m_len    = (std::size_t)n;
+    }
+
+
+    TimestampFormat              m_format;
+    steady_clock::duration       m_resyncInterval;
+    steady_clock::time_point     m_syncSteady;
+    int64_t                      m_syncWallUs   = 0;
+    int64_t                      m_lastUs       = INT64_MIN;
+
+    int64_t                      m_cachedSecond = invalidSecond;
+    std::size_t                  m_fracPos      = 0;
+    std::size_t                  m_len          = 0;
+    char                         m_buf[48]      = { 0 };
+
+}; // class CachedTimestamp
+
+
+
+//-----------------------------------------------------------------------------
+namespace omanip
+{
+
+    struct TimestampManipHelper
+    {
+        CachedTimestamp  *m_pTimestamp;
+
+    }; // struct TimestampManipHelper
+
+    //! Вывод метки времени: fmt << omanip::timestamp(ts) << " " << msg;
+    inline
+    TimestampManipHelper timestamp( CachedTimestamp &ts )
+    {
+        TimestampManipHelper h = { &ts };
+        return h;
+    }
+
+} // namespace omanip
+
+//-----------------------------------------------------------------------------
+//! Метка выводится как строка - учитываются ширина и выравнивание. При заблокированном выводе время не запрашивается
+inline
+SimpleFormatter& operator<<( SimpleFormatter &fmt, const omanip::TimestampManipHelper &ts )
+{
+    if (!fmt.isOutputEnabled())
+        return fmt << ""; // только сброс временного состояния форматирования
+    return fmt << ts.m_pTimestamp->c_str();
+}
+
+
+} // namespace umba
+
+#endif // !UMBA_MCU_USED
+
@@ -0,0 +1,377 @@
+/*! \file
+\brief Декодирование UTF-8 и ширина символов Unicode при выводе на терминал
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "umba/simple_formatter_simd.h"
+
+
+namespace umba
+{
+
+namespace format_utils
+{
+
+//-----------------------------------------------------------------------------
+//! Диапазон кодов символов [first, last]
+struct UnicodeRange
+{
+    uint32_t first;
+    uint32_t last;
+};
+
+//-----------------------------------------------------------------------------
+//! Символ попадает в один из диапазонов отсортированной таблицы (двоичный поиск)
+inline
+bool isInUnicodeRanges( uint32_t cp, const UnicodeRange *pRanges, std::size_t numRanges )
+{
+    if (!numRanges || cp<pRanges[0].first || cp>pRanges[numRanges-1].last)
+        return false;
+
+    std::size_t lo = 0, hi = numRanges;
+    while(lo<hi)
+    {
+        std::size_t mid = (lo+hi)/2;
+        if (cp>pRanges[mid].last)
+            lo = mid+1;
+        else if (cp<pRanges[mid].first)
+            hi = mid;
+        else
+            return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+//! Символы нулевой ширины - комбинируемые знаки (диакритика), соединители, селекторы вариантов
+inline
+bool isZeroWidthChar( uint32_t cp )
+{
+    static const UnicodeRange ranges[] =
+    { { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF }
+    , { 0x05C1, 0x05C2 }, { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }
+    , { 0x064B, 0x065F }, { 0x0670, 0x0670 }, { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 }
+    , { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 }, { 0x0730, 0x074A }
+    , { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x0816, 0x082D }, { 0x0859, 0x085B }
+    , { 0x08D3, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C }, { 0x0941, 0x0948 }
+    , { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 }, { 0x0981, 0x0981 }
+    , { 0x09BC, 0x09BC }, { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 }
+    , { 0x0A01, 0x0A02 }, { 0x0A3C, 0x0A3C }, { 0x0A41, 0x0A51 }, { 0x0A70, 0x0A71 }
+    , { 0x0A81, 0x0A82 }, { 0x0ABC, 0x0ABC }, { 0x0AC1, 0x0AC8 }, { 0x0ACD, 0x0ACD }
+    , { 0x0B01, 0x0B01 }, { 0x0B3C, 0x0B3C }, { 0x0B3F, 0x0B3F }, { 0x0B41, 0x0B44 }
+    , { 0x0B4D, 0x0B4D }, { 0x0BC0, 0x0BC0 }, { 0x0BCD, 0x0BCD }, { 0x0C3E, 0x0C40 }
+    , { 0x0C46, 0x0C56 }, { 0x0CBC, 0x0CBC }, { 0x0CCC, 0x0CCD }, { 0x0D41, 0x0D44 }
+    , { 0x0D4D, 0x0D4D }, { 0x0DCA, 0x0DCA }, { 0x0DD2, 0x0DD6 }, { 0x0E31, 0x0E31 }
+    , { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC }
+    , { 0x0EC8, 0x0ECD }, { 0x0F18, 0x0F19 }, { 0x0F35, 0x0F35 }, { 0x0F37, 0x0F37 }
+    , { 0x0F39, 0x0F39 }, { 0x0F71, 0x0F7E }, { 0x0F80, 0x0F84 }, { 0x0F86, 0x0F87 }
+    , { 0x0F8D, 0x0FBC }, { 0x0FC6, 0x0FC6 }, { 0x102D, 0x1030 }, { 0x1032, 0x1037 }
+    , { 0x1039, 0x103A }, { 0x1160, 0x11FF }, { 0x135D, 0x135F }, { 0x1712, 0x1714 }
+    , { 0x17B4, 0x17B5 }, { 0x17B7, 0x17BD }, { 0x17C6, 0x17C6 }, { 0x17C9, 0x17D3 }
+    , { 0x180B, 0x180E }, { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }
+    , { 0x202A, 0x202E }, { 0x2060, 0x2064 }, { 0x20D0, 0x20FF }, { 0x2CEF, 0x2CF1 }
+    , { 0x2DE0, 0x2DFF }, { 0x302A, 0x302D }, { 0x3099, 0x309A }, { 0xA66F, 0xA672 }
+    , { 0xA674, 0xA67D }, { 0xA69E, 0xA69F }, { 0xA8E0, 0xA8F1 }, { 0xFB1E, 0xFB1E }
+    , { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF }, { 0x1D167, 0x1D169 }
+    , { 0x1D17B, 0x1D182 }, { 0x1F3FB, 0x1F3FF }, { 0xE0001, 0xE0001 }, { 0xE0020, 0xE007F }
+    , { 0xE0100, 0xE01EF }
+    };
+
+    return isInUnicodeRanges(cp, &ranges[0], sizeof(ranges)/sizeof(ranges[0]));
+}
+
+//-----------------------------------------------------------------------------
+//! Широкие символы (East Asian Wide/Fullwidth и эмодзи), занимающие две позиции терминала
+inline
+bool isWideChar( uint32_t cp )
+{
+    static const UnicodeRange ranges[] =
+    { { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }
+    , { 0x23F0, 0x23F0 }, { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }
+    , { 0x2648, 0x2653 }, { 0x267F, 0x267F }, { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }
+    , { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 }, { 0x26CE, 0x26CE }
+    , { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 }
+    , { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }
+    , { 0x2728, 0x2728 }, { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }
+    , { 0x2757, 0x2757 }, { 0x2795, 0x2797 }, { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }
+    , { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 }, { 0x2E80, 0x3029 }
+    , { 0x302E, 0x303E }, { 0x3041, 0x3098 }, { 0x309B, 0x33FF }, { 0x3400, 0x4DBF }
+    , { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF }, { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }
+    , { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 }
+    , { 0xFFE0, 0xFFE6 }, { 0x16FE0, 0x16FE4 }, { 0x17000, 0x18CFF }, { 0x1B000, 0x1B2FF }
+    , { 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }
+    , { 0x1F200, 0x1F251 }, { 0x1F300, 0x1F3FA }, { 0x1F400, 0x1F64F }, { 0x1F680, 0x1F6FF }
+    , { 0x1F7E0, 0x1F7EB }, { 0x1F90C, 0x1F9FF }, { 0x1FA70, 0x1FAFF }, { 0x20000, 0x2FFFD }
+    , { 0x30000, 0x3FFFD }
+    };
+
+    return isInUnicodeRanges(cp, &ranges[0], sizeof(ranges)/sizeof(ranges[0]));
+}
+
+//-----------------------------------------------------------------------------
+//! Ширина символа на терминале: 0 - комбинируемый знак, 2 - широкий символ, иначе 1
+inline
+int unicodeCharWidth( uint32_t cp )
+{
+    if (cp<0x0300)
+        return 1;
+    if (isZeroWidthChar(cp))
+        return 0;
+    if (isWideChar(cp))
+        return 2;
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+//! Декодирует один символ UTF-8. Возвращает количество байт символа (не менее 1)
+/*! Некорректные последовательности (обрезанные, overlong, суррогаты, > U+10FFFF) декодируются
+    побайтно: байт считается символом U+FFFD
+ */
+inline
+std::size_t utf8DecodeChar( const char *str, std::size_t len, uint32_t &cp )
+{
+    const unsigned char *p = (const unsigned char*)str;
+    unsigned c0 = p[0];
+
+    if (c0<0x80)
+    {
+        cp = c0;
+        return 1;
+    }
+
+    cp = 0xFFFD;
+
+    std::size_t n   = 0;
+    uint32_t    res = 0;
+    uint32_t    minCp = 0;
+
+    if ((c0&0xE0)==0xC0)      { n = 2; res = c0&0x1F; minCp = 0x80;    }
+    else if ((c0&0xF0)==0xE0) { n = 3; res = c0&0x0F; minCp = 0x800;   }
+    else if ((c0&0xF8)==0xF0) { n = 4; res = c0&0x07; minCp = 0x10000; }
+    else
+        return 1;
+
+    if (n>len)
+        return 1;
+
+    for(std::size_t i=1; i!=n; ++i)
+    {
+        if ((p[i]&0xC0)!=0x80)
+            return 1;
+        res = (res<<6) | (p[i]&0x3F);
+    }
+
+    if (res<minCp || res>0x10FFFF || (res>=0xD800 && res<=0xDFFF))
+        return 1;
+
+    cp = res;
+    return n;
+}
+
+//-----------------------------------------------------------------------------
+//! Ширина строки UTF-8 на терминале (количество позиций)
+/*! Начальный ASCII-участок ищется SIMD-сканером, его ширина равна длине. Декодирование с поиском
+    по таблицам ширины выполняется только после первого не-ASCII байта, при этом ASCII-участки
+    между многобайтными символами также пропускаются сканером
+ */
+inline
+std::size_t utf8DisplayWidth( const char *str, std::size_t len )
+{
+    std::size_t asciiLen = findNonAscii(str, len);
+    if (asciiLen==len)
+        return len;
+
+    std::size_t width = asciiLen;
+    std::size_t i     = asciiLen;
+
+    while(i!=len)
+    {
+        if ((unsigned char)str[i]<0x80)
+        {
+            std::size_t runLen = findNonAscii(str+i, len-i);
+            width += runLen;
+            i     += runLen;
+            continue;
+        }
+
+        uint32_t cp;
+        i     += utf8DecodeChar(str+i, len-i, cp);
+        width += (std::size_t)unicodeCharWidth(cp);
+    }
+
+    return width;
+}
+
+
+//-----------------------------------------------------------------------------
+//! Тип символа широкой строки, выводимой с перекодированием в UTF-8
+template<typename CharT>
+struct is_wide_char : std::integral_constant< bool, std::is_same<CharT, wchar_t>::value
+                                                 || std::is_same<CharT, char16_t>::value
+                                                 || std::is_same<CharT, char32_t>::value
+                                            >
+{};
+
+//-----------------------------------------------------------------------------
+//! Количество байт UTF-8 для корректного символа cp
+inline
+std::size_t utf8CharLen( uint32_t cp )
+{
+    return cp<0x80 ? 1 : (cp<0x800 ? 2 : (cp<0x10000 ? 3 : 4));
+}
+
+//-----------------------------------------------------------------------------
+//! Кодирует корректный символ cp в UTF-8, возвращает количество записанных байт
+inline
+std::size_t utf8EncodeChar( uint32_t cp, char *pBuf )
+{
+    if (cp<0x80)
+    {
+        pBuf[0] = (char)cp;
+        return 1;
+    }
+    if (cp<0x800)
+    {
+        pBuf[0] = (char)(0xC0 | (cp>>6));
+        pBuf[1] = (char)(0x80 | (cp&0x3F));
+        return 2;
+    }
+    if (cp<0x10000)
+    {
+        pBuf[0] = (char)(0xE0 | (cp>>12));
+        pBuf[1] = (char)(0x80 | ((cp>>6)&0x3F));
+        pBuf[2] = (char)(0x80 | (cp&0x3F));
+        return 3;
+    }
+    pBuf[0] = (char)(0xF0 | (cp>>18));
+    pBuf[1] = (char)(0x80 | ((cp>>12)&0x3F));
+    pBuf[2] = (char)(0x80 | ((cp>>6)&0x3F));
+    pBuf[3] = (char)(0x80 | (cp&0x3F));
+    return 4;
+}
+
+//-----------------------------------------------------------------------------
+//! Декодирует один символ строки UTF-16 (2х-байтные единицы) или UTF-32 (4х-байтные единицы). Возвращает количество единиц
+/*! Одиночные суррогаты и значения вне диапазона Unicode декодируются как U+FFFD
+ */
+template<typename CharT>
+std::size_t wideDecodeChar( const CharT *p, std::size_t len, uint32_t &cp )
+{
+    if (sizeof(CharT)==2)
+    {
+        uint32_t u = (uint16_t)p[0];
+        if (u<0xD800 || u>0xDFFF)
+        {
+            cp = u;
+            return 1;
+        }
+
+        if (u<=0xDBFF && len>1)
+        {
+            uint32_t u2 = (uint16_t)p[1];
+            if (u2>=0xDC00 && u2<=0xDFFF)
+            {
+                cp = 0x10000 + ((u-0xD800)<<10) + (u2-0xDC00);
+                return 2;
+            }
+        }
+
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    uint32_t u = (uint32_t)p[0];
+    cp = (u>0x10FFFF || (u>=0xD800 && u<=0xDFFF)) ? 0xFFFD : u;
+    return 1;
+}
+
+//-----------------------------------------------------------------------------
+//! Длина широкой строки, завершенной нулем, но не более maxLen единиц
+template<typename CharT>
+std::size_t wideStrLen( const CharT *str, std::size_t maxLen = (std::size_t)-1 )
+{
+    std::size_t len = 0;
+    while(len!=maxLen && str[len])
+        ++len;
+    return len;
+}
+
+//-----------------------------------------------------------------------------
+//! Перекодирует широкую строку в UTF-8 в буфер pDst размером dstSize байт
+/*! Перекодирование останавливается на символе, который не помещается в буфер целиком.
+    ASCII-участки копируются SIMD-ядром. Возвращает количество записанных байт, в srcUsed - количество
+    использованных единиц исходной строки
+ */
+template<typename CharT>
+std::size_t transcodeToUtf8( const CharT *p, std::size_t len, char *pDst, std::size_t dstSize, std::size_t &srcUsed )
+{
+    std::size_t i   = 0;
+    std::size_t pos = 0;
+
+    while(i!=len)
+    {
+        std::size_t room = dstSize - pos;
+        std::size_t n    = copyAsciiPrefix(p+i, len-i < room ? len-i : room, pDst+pos);
+        i   += n;
+        pos += n;
+
+        if (i==len || pos==dstSize)
+            break;
+
+        uint32_t    cp;
+        std::size_t numUnits = wideDecodeChar(p+i, len-i, cp);
+        if (utf8CharLen(cp) > dstSize-pos)
+            break;
+
+        pos += utf8EncodeChar(cp, pDst+pos);
+        i   += numUnits;
+    }
+
+    srcUsed = i;
+    return pos;
+}
+
+//-----------------------------------------------------------------------------
+//! Измерение широкой строки в UTF-8: сколько единиц строки помещается в maxBytes байт
+/*! В utf8Len возвращается длина результата в байтах, в dispWidth - ширина в позициях терминала.
+    Строка перекодируется порциями во временный буфер, ширина порций считается utf8DisplayWidth
+ */
+template<typename CharT>
+std::size_t wideMeasureUtf8( const CharT *p, std::size_t len, std::size_t maxBytes, std::size_t &utf8Len, std::size_t &dispWidth )
+{
+    char buf[256];
+
+    std::size_t i = 0;
+    utf8Len   = 0;
+    dispWidth = 0;
+
+    while(i!=len)
+    {
+        std::size_t room = maxBytes - utf8Len;
+        if (room>sizeof(buf))
+            room = sizeof(buf);
+
+        std::size_t used = 0;
+        std::size_t n    = transcodeToUtf8(p+i, len-i, &buf[0], room, used);
+        if (!used)
+            break;
+
+        utf8Len   += n;
+        dispWidth += utf8DisplayWidth(&buf[0], n);
+        i         += used;
+    }
+
+    return i;
+}
+
+
+} // namespace format_utils
+
+} // namespace umba
+
@@ -0,0 +1,253 @@
+/*! \file
+\brief Устройство вывода в файловый дескриптор POSIX со сборкой фрагментов в iovec и выводом одним writev
+*/
+
+#pragma once
+
+#include "umba/simple_formatter.h"
+
+#if !defined(UMBA_MCU_USED) && (defined(__unix__) || defined(__APPLE__))
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace umba
+{
+
+
+//-----------------------------------------------------------------------------
+//! Устройство вывода в файловый дескриптор, собирающее фрагменты строки в массив iovec
+/*! Обычные данные (writeBuf, writeChar) копируются в небольшую арену; соседние копии в арене
+    объединяются в один элемент iovec. Неизменяемые данные (IStableBufWriter::writeStableBuf -
+    литералы omanip::literal, заполнение отступов) не копируются - элемент
+    iovec ссылается на них напрямую. Накопленное выводится одним вызовом writev при flush(),
+    а также при заполнении массива iovec или арены.
+
+    Подключение:
+    \code
+    PosixWritevCharWriter w(STDOUT_FILENO);
+    SimpleFormatter fmt(&w);
+    fmt.setStableBufWriter(&w);
+    fmt << omanip::literal("rx: ") << n << omanip::endl;
+    \endcode
+
+    Короткие неизменяемые фрагменты (до minRefLen байт) дешевле скопировать, чем передавать ядру
+    отдельным элементом iovec - они копируются в арену.
+
+    Ошибки вывода (кроме EINTR) не прерывают работу: накопленные данные отбрасываются,
+    код ошибки доступен через getLastError()
+ */
+class PosixWritevCharWriter : public ICharWriter
+                            , public IStableBufWriter
+{
+
+public:
+
+    //! Размер арены для копируемых данных
+    static const std::size_t arenaSize = 4096;
+    //! Данные writeBuf не короче этого размера не копируются - выводятся сразу вместе с накопленным
+    static const std::size_t directWriteLen = arenaSize/4;
+    //! Неизменяемые фрагменты короче этого размера копируются в арену
+    static const std::size_t minRefLen = 16;
+
+    #if defined(IOV_MAX) && IOV_MAX<64
+        static const int maxIov = IOV_MAX;
+    #else
+        static const int maxIov = 64;
+    #endif
+
+    //! closeOnDestroy - закрыть дескриптор в деструкторе
+    explicit PosixWritevCharWriter( int fd, bool closeOnDestroy = false )
+    : m_fd(fd)
+    , m_closeOnDestroy(closeOnDestroy)
+    , m_isTerminal(fd>=0 && ::isatty(fd)!=0)
+    {}
+
+    ~PosixWritevCharWriter()
+    {
+        submit();
+        if (m_closeOnDestroy && m_fd>=0)
+            ::close(m_fd);
+    }
+
+    int getFd() const
+    {
+        return m_fd;
+    }
+
+    //! errno последней неудачной записи (0 - ошибок не было)
+    int getLastError() const
+    {
+        return m_lastError;
+    }
+
+    //! Количество вызовов writev (для оценки эффективности сборки)
+    std::size_t getWritevCount() const
+    {
+        return m_writevCount;
+    }
+
+    //-------------------
+    virtual void writeChar( char ch ) override
+    {
+        copyToArena((const uint8_t*)&ch, 1);
+    }
+
+    virtual void writeBuf( const uint8_t* pBuf, size_t len ) override
+    {
+        if (!len)
+            return;
+
+        if (len>=directWriteLen)
+        {
+            // Данные действительны только на время вызова - выводим их сразу, вместе с накопленным
+            if (m_numIov==maxIov)
+                submit();
+            appendRef(pBuf, len);
+            submit();
+            return;
+        }
+
+        copyToArena(pBuf, len);
+    }
+
+    virtual void writeStableBuf( const uint8_t *pBuf, size_t len ) override
+    {
+        if (!len)
+            return;
+
+        if (len<minRefLen)
+        {
+            copyToArena(pBuf, len);
+            return;
+        }
+
+        if (m_numIov==maxIov)
+            submit();
+        appendRef(pBuf, len);
+    }
+
+    virtual void flush() override
+    {
+        submit();
+    }
+
+    virtual bool isTerminal() const override
+    {
+        return m_isTerminal;
+    }
+
+
+protected:
+
+    //-------------------
+    //! Добавление элемента iovec; если данные продолжают последний элемент, он расширяется
+    void appendRef( const uint8_t *pBuf, std::size_t len )
+    {
+        if (m_numIov)
+        {
+            struct iovec &last = m_iov[m_numIov-1];
+            if ((const uint8_t*)last.iov_base + last.iov_len == pBuf)
+            {
+                last.iov_len += len;
+                return;
+            }
+        }
+
+        m_iov[m_numIov].iov_base = (void*)pBuf;
+        m_iov[m_numIov].iov_len  = len;
+        ++m_numIov;
+    }
+
+    void copyToArena( const uint8_t *pBuf, std::size_t len )
+    {
+        if (arenaSize-m_arenaUsed<len || (m_numIov==maxIov && !isArenaTail(&m_arena[m_arenaUsed])))
+            submit();
+
+        uint8_t *pDst = &m_arena[m_arenaUsed];
+        std::memcpy(pDst, pBuf, len);
+        m_arenaUsed += len;
+        appendRef(pDst, len);
+    }
+
+    //! Заканчивается ли последний элемент iovec в позиции pos арены (тогда новая копия к нему присоединяется)
+    bool isArenaTail( const uint8_t *pos ) const
+    {
+        if (!m_numIov)
+            return false;
+        const struct iovec &last = m_iov[m_numIov-1];
+        return (const uint8_t*)last.iov_base + last.iov_len == pos;
+    }
+
+    //-------------------
+    //! Вывод накопленного одним writev (с дозаписью при частичной записи)
+    void submit()
+    {
+        struct iovec *pIov = &m_iov[0];
+        int           n    = m_numIov;
+
+        while(n)
+        {
+            ssize_t res = ::writev(m_fd, pIov, n);
+            if (res<0)
+            {
+                if (errno==EINTR)
+                    continue;
+                m_lastError = errno;
+                break;
+            }
+
+            ++m_writevCount;
+
+            // Частичная запись - пропускаем выведенные элементы, остаток первого невыведенного дописываем
+            std::size_t written = (std::size_t)res;
+            while(n && written>=pIov->iov_len)
+            {
+                written -= pIov->iov_len;
+                ++pIov;
+                --n;
+            }
+
+            if (n)
+            {
+                pIov->iov_base  = (void*)((const uint8_t*)pIov->iov_base + written);
+                pIov->iov_len  -= written;
+            }
+        }
+
+        m_numIov    = 0;
+        m_arenaUsed = 0;
+    }
+
+
+    // disable copying
+    PosixWritevCharWriter(const PosixWritevCharWriter&);
+    PosixWritevCharWriter& operator=(const PosixWritevCharWriter&);
+
+
+    int                 m_fd;
+    bool                m_closeOnDestroy;
+    bool                m_isTerminal;
+
+    int                 m_lastError   = 0;
+    std::size_t         m_writevCount = 0;
+
+    struct iovec        m_iov[maxIov];
+    int                 m_numIov      = 0;
+
+    uint8_t             m_arena[arenaSize];
+    std::size_t         m_arenaUsed   = 0;
+
+}; // class PosixWritevCharWriter
+
+
+} // namespace umba
+
+#endif // !UMBA_MCU_USED && POSIX
+
@@ -1,5 +1,9 @@
 #include <algorithm>
 
+#if !defined(UMBA_MCU_USED)
+    #include <chrono>
+#endif
+
 #include "inc/umba/simple_formatter.h"
 #include "umba/preprocessor.h"
 
@@ -43,37 +47,28 @@ SimpleFormatter::FormatFlags SimpleFormatter::flags() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 SimpleFormatter::FormatFlags SimpleFormatter::flags( SimpleFormatter::FormatFlags flags )
 {
-    FormatFlags res = m_formatState.flags;
-    m_formatState.flags = flags;
-    return res;
+    return setStateField(stateFieldFlags, &FormatState::flags, flags);
 }
 
 //-----------------------------------------------------------------------------
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 SimpleFormatter::FormatFlags SimpleFormatter::setf( SimpleFormatter::FormatFlags flags )
 {
-    FormatFlags res = m_formatState.flags;
-    m_formatState.flags |= flags;
-    return res;
+    return setStateField(stateFieldFlags, &FormatState::flags, m_formatState.flags | flags);
 }
 
 //-----------------------------------------------------------------------------
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 SimpleFormatter::FormatFlags SimpleFormatter::setf( SimpleFormatter::FormatFlags flags, SimpleFormatter::FormatFlags mask )
 {
-    FormatFlags res = m_formatState.flags;
-    m_formatState.flags &= ~mask;
-    m_formatState.flags |= flags&mask;
-    return res;
+    return setStateField(stateFieldFlags, &FormatState::flags, (m_formatState.flags & ~mask) | (flags&mask));
 }
 
 //-----------------------------------------------------------------------------
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 SimpleFormatter::FormatFlags SimpleFormatter::unsetf( SimpleFormatter::FormatFlags mask )
 {
-    FormatFlags res = m_formatState.flags;
-    m_formatState.flags &= ~mask;
-    return res;
+    return setStateField(stateFieldFlags, &FormatState::flags, m_formatState.flags & ~mask);
 }
 
 //-----------------------------------------------------------------------------
@@ -87,9 +82,40 @@ SimpleFormatter::FormatState SimpleFormatter::getState() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::setState( SimpleFormatter::FormatState &st )
 {
+    if (m_stateSaved && m_stateDirtyMask!=stateFieldAll)
+    {
+        // Запоминаем исходные значения всех еще не измененных полей
+        FormatState orgState = m_formatState;
+        copyStateFields(orgState, m_formatStateSaved, m_stateDirtyMask);
+        m_formatStateSaved = orgState;
+        m_stateDirtyMask   = stateFieldAll;
+    }
+
     m_formatState = st;
 }
 
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::copyStateFields( SimpleFormatter::FormatState &dst, const SimpleFormatter::FormatState &src, unsigned fieldsMask )
+{
+    if (fieldsMask==stateFieldAll)
+    {
+        dst = src;
+        return;
+    }
+
+    if (fieldsMask&stateFieldFlags       ) dst.flags        = src.flags       ;
+    if (fieldsMask&stateFieldWidth       ) dst.width        = src.width       ;
+    if (fieldsMask&stateFieldPrecision   ) dst.precision    = src.precision   ;
+    if (fieldsMask&stateFieldFill        ) dst.fill         = src.fill        ;
+    if (fieldsMask&stateFieldDecGroupSep ) dst.decGroupSep  = src.decGroupSep ;
+    if (fieldsMask&stateFieldGroupSep    ) dst.groupSep     = src.groupSep    ;
+    if (fieldsMask&stateFieldDecGroupSize) dst.decGroupSize = src.decGroupSize;
+    if (fieldsMask&stateFieldGroupSize   ) dst.groupSize    = src.groupSize   ;
+    if (fieldsMask&stateFieldDecimalPoint) dst.decimalPoint = src.decimalPoint;
+    if (fieldsMask&stateFieldMaxLength   ) dst.maxLength    = src.maxLength   ;
+}
+
 //-----------------------------------------------------------------------------
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 unsigned SimpleFormatter::getColor(ColoringLevel lvl)
@@ -114,6 +140,15 @@ void SimpleFormatter::setColor(ColoringLevel lvl, umba::term::colors::SgrColor c
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::coloring( ColoringLevel lvl )
 {
+    // Запоминаем наиболее важный уровень строки - для немедленного сброса (см. setFlushLevel) и префикса строки.
+    // normal - только сброс цвета, уровень строки он не задает
+    if (lvl!=ColoringLevel::normal)
+    {
+        ColoringLevel sev = log_utils::severity(lvl);
+        if ((unsigned)sev < (unsigned)m_msgLevel)
+            m_msgLevel = sev;
+    }
+
     //coloring(getColor(lvl));
 /*
     if (lvl==ColoringLevel::normal)
@@ -133,18 +168,37 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::coloring( umba::term::colors::SgrColor clr )
 {
     if (m_disableOutput) return;
-    if (m_charWriter)
-        m_charWriter->setTermColors(clr);
+    if (!m_charWriter) return;
+
+    // Поддержка цвета проверяется один раз; для файлов, строк и прочих не-терминалов смена цвета ничего не делает
+    if (m_colorsSupported<0)
+        m_colorsSupported = m_charWriter->isTerminal() ? 1 : 0;
+    if (!m_colorsSupported)
+        return;
+
+    // endl/cret/feed и манипуляторы уровней постоянно выставляют один и тот же цвет - повторно не выводим
+    if (m_curColorValid && m_curColor==clr)
+        return;
+
+    m_curColor      = clr;
+    m_curColorValid = true;
+
+    // Смена цвета выполняется устройством сразу - пока в очереди неблокирующего режима есть данные, откладываем ее
+    if (m_nbQueue && pumpNonBlock())
+    {
+        nonBlockQueueColor(clr);
+        return;
+    }
+
+    m_charWriter->setTermColors(clr);
 }
 
 //-----------------------------------------------------------------------------
 // for iomanips - each manip must call saveFormatState
+// Nothing is copied here - setters stash original values of the fields on first modification
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::saveFormatState()
 {
-    if (m_stateSaved)
-       return;
-    m_formatStateSaved = m_formatState;
     m_stateSaved = true;
 }
 
@@ -155,7 +209,11 @@ void SimpleFormatter::restoreFormatState()
 {
     if (!m_stateSaved)
         return;
-    m_formatState = m_formatStateSaved;
+    if (m_stateDirtyMask)
+    {
+        copyStateFields(m_formatState, m_formatStateSaved, m_stateDirtyMask);
+        m_stateDirtyMask = 0;
+    }
     m_stateSaved = false;
 }
 
@@ -170,9 +228,7 @@ int SimpleFormatter::width() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 int SimpleFormatter::width( int w )
 {
-    int res = m_formatState.width;
-    m_formatState.width = w;
-    return res;
+    return setStateField(stateFieldWidth, &FormatState::width, w);
 }
 
 //-----------------------------------------------------------------------------
@@ -186,9 +242,24 @@ int SimpleFormatter::precision() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 int SimpleFormatter::precision( int p )
 {
-    int res = m_formatState.precision;
-    m_formatState.precision = p;
-    return res;
+    if (p>INT16_MAX) p = INT16_MAX;
+    if (p<INT16_MIN) p = INT16_MIN;
+    return setStateField(stateFieldPrecision, &FormatState::precision, p);
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+int SimpleFormatter::maxlength() const
+{
+    return m_formatState.maxLength;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+int SimpleFormatter::maxlength( int len )
+{
+    if (len<0) len = 0;
+    return setStateField(stateFieldMaxLength, &FormatState::maxLength, len);
 }
 
 //-----------------------------------------------------------------------------
@@ -202,9 +273,7 @@ char SimpleFormatter::fill() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 char SimpleFormatter::fill( char c )
 {
-    int res = m_formatState.fill;
-    m_formatState.fill = c;
-    return (char)res;
+    return setStateField(stateFieldFill, &FormatState::fill, c);
 }
 
 //-----------------------------------------------------------------------------
@@ -218,9 +287,9 @@ int SimpleFormatter::groupsize() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 int SimpleFormatter::groupsize(int size)
 {
-    int res = m_formatState.groupSize;
-    m_formatState.groupSize = size;
-    return res;
+    if (size>INT8_MAX) size = INT8_MAX;
+    if (size<INT8_MIN) size = INT8_MIN;
+    return setStateField(stateFieldGroupSize, &FormatState::groupSize, size);
 }
 
 //-----------------------------------------------------------------------------
@@ -234,9 +303,9 @@ int SimpleFormatter::decgroupsize() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 int SimpleFormatter::decgroupsize(int size)
 {
-    int res = m_formatState.decGroupSize;
-    m_formatState.decGroupSize = size;
-    return res;
+    if (size>INT8_MAX) size = INT8_MAX;
+    if (size<INT8_MIN) size = INT8_MIN;
+    return setStateField(stateFieldDecGroupSize, &FormatState::decGroupSize, size);
 }
 
 //-----------------------------------------------------------------------------
@@ -250,9 +319,7 @@ char SimpleFormatter::groupsep() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 char SimpleFormatter::groupsep(char sepCh)
 {
-    char res = m_formatState.groupSep;
-    m_formatState.groupSep = sepCh;
-    return res;
+    return setStateField(stateFieldGroupSep, &FormatState::groupSep, sepCh);
 }
 
 //-----------------------------------------------------------------------------
@@ -266,9 +333,7 @@ char SimpleFormatter::decgroupsep() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 char SimpleFormatter::decgroupsep(char sepCh)
 {
-    char res = m_formatState.decGroupSep;
-    m_formatState.decGroupSep = sepCh;
-    return res;
+    return setStateField(stateFieldDecGroupSep, &FormatState::decGroupSep, sepCh);
 }
 
 //-----------------------------------------------------------------------------
@@ -282,9 +347,7 @@ char SimpleFormatter::decpoint() const
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 char SimpleFormatter::decpoint(char pntCh)
 {
-    char res = m_formatState.decimalPoint;
-    m_formatState.decimalPoint = pntCh;
-    return res;
+    return setStateField(stateFieldDecimalPoint, &FormatState::decimalPoint, pntCh);
 }
     
 //-----------------------------------------------------------------------------
@@ -326,7 +389,7 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 int SimpleFormatter::base(int b)
 {
     int res = base();
-    m_formatState.flags = (m_formatState.flags & ~basefield) | baseToFlags(b);
+    setStateField(stateFieldFlags, &FormatState::flags, (m_formatState.flags & ~basefield) | baseToFlags(b));
     return res;
 }
 
@@ -335,7 +398,112 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::flush()
 {
     if (m_disableOutput) return;
+
+    // В неблокирующем режиме устройство сбрасывается только после вывода всей очереди (в pumpNonBlock)
+    if (m_nbQueue && pumpNonBlock())
+    {
+        m_nbFlushPending = true;
+        return;
+    }
+
     m_charWriter->flush();
+
+    m_unflushedBytes = 0;
+    if (m_flushPolicy==FlushPolicy::perInterval && m_flushTickSource)
+        m_lastFlushTick = m_flushTickSource();
+}
+
+//-----------------------------------------------------------------------------
+#if !defined(UMBA_MCU_USED)
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+uint32_t flushTickSourceSteadyClock()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setFlushPolicy( FlushPolicy policy, uint32_t param )
+{
+    m_flushPolicy    = policy;
+    m_flushParam     = param;
+    m_unflushedBytes = 0;
+
+    #if !defined(UMBA_MCU_USED)
+    if (!m_flushTickSource)
+        m_flushTickSource = flushTickSourceSteadyClock;
+    #endif
+
+    if (m_flushTickSource)
+        m_lastFlushTick = m_flushTickSource();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+FlushPolicy SimpleFormatter::getFlushPolicy() const
+{
+    return m_flushPolicy;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setFlushTickSource( FlushTickSource tickSource )
+{
+    m_flushTickSource = tickSource;
+    if (m_flushTickSource)
+        m_lastFlushTick = m_flushTickSource();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setFlushLevel( ColoringLevel lvl )
+{
+    m_flushLevel = log_utils::severity(lvl);
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::requestFlush( bool lineEnd )
+{
+    if (m_disableOutput) return;
+    if (!m_charWriter) return;
+
+    // Уровень строк, завершенных после последнего сброса, и текущей строки
+    ColoringLevel lvl = (unsigned)m_msgLevel < (unsigned)m_doneLinesLevel ? m_msgLevel : m_doneLinesLevel;
+    bool doFlush = (unsigned)lvl <= (unsigned)m_flushLevel;
+
+    if (lineEnd)
+        m_msgLevel = ColoringLevel::normal;
+    if (lineEnd || doFlush)
+        m_doneLinesLevel = ColoringLevel::normal;
+
+    if (!doFlush)
+    {
+        switch(m_flushPolicy)
+        {
+            case FlushPolicy::perLine:
+                 doFlush = lineEnd;
+                 break;
+
+            case FlushPolicy::perBytes:
+                 doFlush = m_unflushedBytes!=0 && m_unflushedBytes>=(size_t)m_flushParam;
+                 break;
+
+            case FlushPolicy::perInterval:
+                 if (!m_flushTickSource)
+                     doFlush = lineEnd; // нет источника времени - сбрасываем построчно
+                 else
+                     doFlush = m_unflushedBytes!=0 && (uint32_t)(m_flushTickSource() - m_lastFlushTick) >= m_flushParam;
+                 break;
+
+            default: // FlushPolicy::explicitOnly
+                 break;
+        }
+    }
+
+    if (doFlush)
+        flush();
 }
 
 //-----------------------------------------------------------------------------
@@ -351,8 +519,12 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::putEndl()
 {
     if (m_disableOutput) return;
-    if (m_charWriter) 
+    if (m_nbQueue && m_charWriter)
+        nonBlockPutEndl();
+    else if (m_charWriter) 
         m_charWriter->putEndl();
+    ++m_unflushedBytes;
+    startLine();
 }
 
 //-----------------------------------------------------------------------------
@@ -360,8 +532,12 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::putCR()
 {
     if (m_disableOutput) return;
-    if (m_charWriter) 
+    if (m_nbQueue && m_charWriter)
+        nonBlockWrite((const uint8_t*)"\r", 1);
+    else if (m_charWriter) 
         m_charWriter->putCR();
+    ++m_unflushedBytes;
+    startLine();
 }
 
 //-----------------------------------------------------------------------------
@@ -369,8 +545,12 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::putFF()
 {
     if (m_disableOutput) return;
-    if (m_charWriter) 
+    if (m_nbQueue && m_charWriter)
+        nonBlockWrite((const uint8_t*)"\f", 1);
+    else if (m_charWriter) 
         m_charWriter->putFF();
+    ++m_unflushedBytes;
+    startLine();
 }
 
 //-----------------------------------------------------------------------------
@@ -378,8 +558,141 @@ UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::writeBuf( const uint8_t *pBuf, size_t sz )
 {
     if (m_disableOutput) return;
+
+    if (m_linePrefixActive)
+    {
+        writeBufPrefixed(pBuf, sz);
+        return;
+    }
+
     if (m_charWriter) 
-        m_charWriter->writeBuf(pBuf, sz);
+        sinkWrite(pBuf, sz);
+    m_unflushedBytes += sz;
+}
+
+//-----------------------------------------------------------------------------
+// Вывод с префиксом строк - префикс выводится лениво, перед первым символом строки,
+// поэтому после последнего перевода строки "висящий" префикс не появляется
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::writeBufPrefixed( const uint8_t *pBuf, size_t sz )
+{
+    if (!m_charWriter)
+        return;
+
+    while(sz)
+    {
+        if (m_atLineStart)
+        {
+            m_atLineStart = false;
+            writeLinePrefix();
+        }
+
+        const uint8_t *pNl   = (const uint8_t*)std::memchr(pBuf, '\n', sz);
+        size_t        segLen = pNl ? (size_t)(pNl - pBuf) + 1 : sz;
+
+        sinkWrite(pBuf, segLen);
+        m_unflushedBytes += segLen;
+
+        pBuf += segLen;
+        sz   -= segLen;
+
+        if (pNl)
+            startLine();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Начало новой строки: уровень завершенной строки больше не относится к следующей
+// и учитывается только при ближайшем requestFlush
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::startLine()
+{
+    if ((unsigned)m_msgLevel < (unsigned)m_doneLinesLevel)
+        m_doneLinesLevel = m_msgLevel;
+    m_msgLevel    = ColoringLevel::normal;
+    m_atLineStart = true;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::writeLinePrefix()
+{
+    if (m_pLinePrefixProvider)
+    {
+        const char *pPrefix   = 0;
+        size_t      prefixLen = 0;
+        m_pLinePrefixProvider->getLinePrefix(m_msgLevel, pPrefix, prefixLen);
+        if (prefixLen)
+        {
+            sinkWrite((const uint8_t*)pPrefix, prefixLen);
+            m_unflushedBytes += prefixLen;
+        }
+    }
+
+    if (m_linePrefixLen)
+    {
+        sinkWrite((const uint8_t*)m_linePrefix, m_linePrefixLen);
+        m_unflushedBytes += m_linePrefixLen;
+    }
+
+    static const char spaces[] = "                                ";
+    const size_t maxChunk = sizeof(spaces)-1;
+
+    size_t indent = (size_t)m_indentStack.total();
+    while(indent)
+    {
+        size_t chunk = indent<maxChunk ? indent : maxChunk;
+        sinkWriteStable((const uint8_t*)&spaces[0], chunk);
+        m_unflushedBytes += chunk;
+        indent -= chunk;
+    }
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::updateLinePrefixActive()
+{
+    m_linePrefixActive = m_pLinePrefixProvider!=0 || m_linePrefixLen!=0 || m_indentStack.total()!=0;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setLinePrefix( const char *prefix )
+{
+    m_linePrefix    = prefix;
+    m_linePrefixLen = prefix ? std::strlen(prefix) : 0;
+    updateLinePrefixActive();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setLinePrefixProvider( ILinePrefixProvider *pProvider )
+{
+    m_pLinePrefixProvider = pProvider;
+    updateLinePrefixActive();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::pushIndent( int n )
+{
+    m_indentStack.push(n);
+    updateLinePrefixActive();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::popIndent()
+{
+    m_indentStack.pop();
+    updateLinePrefixActive();
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+int SimpleFormatter::getIndent() const
+{
+    return m_indentStack.total();
 }
 
 //-----------------------------------------------------------------------------
@@ -389,6 +702,239 @@ void SimpleFormatter::writeBuf( const char *pBuf, size_t sz )
     writeBuf((const uint8_t*)pBuf, sz);
 }
 
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::writeStableBuf( const char *pBuf, size_t sz )
+{
+    if (m_disableOutput) return;
+
+    // С префиксами вывод разбивается по строкам - обычным путем, с копированием
+    if (m_linePrefixActive)
+    {
+        writeBufPrefixed((const uint8_t*)pBuf, sz);
+        return;
+    }
+
+    if (m_charWriter)
+        sinkWriteStable((const uint8_t*)pBuf, sz);
+    m_unflushedBytes += sz;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::setNonBlockMode( uint8_t *pQueueBuf, size_t queueSize, NonBlockOverflowPolicy policy )
+{
+    // Данные из прежней очереди не теряем - при выключении режима или смене буфера выводим их с блокировкой
+    nonBlockPump(true);
+
+    m_nbQueue        = queueSize ? pQueueBuf : 0;
+    m_nbSize         = m_nbQueue ? queueSize : 0;
+    m_nbHead         = 0;
+    m_nbCount        = 0;
+    m_nbPolicy       = policy;
+    m_nbNumColors    = 0;
+    m_nbFlushPending = false;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+size_t SimpleFormatter::pumpNonBlock()
+{
+    return nonBlockPump(false);
+}
+
+//-----------------------------------------------------------------------------
+// Вывод очереди; отложенные смены цвета выполняются, когда выведены все данные, стоявшие перед ними.
+// block - выводить с блокировкой (при выключении режима)
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+size_t SimpleFormatter::nonBlockPump( bool block )
+{
+    if (!m_nbQueue || !m_charWriter)
+        return m_nbCount;
+
+    for(;;)
+    {
+        while(m_nbNumColors && m_nbColors[0].pos==m_nbOutTotal)
+        {
+            m_charWriter->setTermColors(m_nbColors[0].clr);
+            --m_nbNumColors;
+            for(unsigned i=0; i!=m_nbNumColors; ++i)
+                m_nbColors[i] = m_nbColors[i+1];
+        }
+
+        if (!m_nbCount)
+            break;
+
+        size_t contig = m_nbSize - m_nbHead;
+        if (contig>m_nbCount)
+            contig = m_nbCount;
+        if (m_nbNumColors && m_nbColors[0].pos - m_nbOutTotal < contig)
+            contig = m_nbColors[0].pos - m_nbOutTotal;
+
+        size_t n = contig;
+        if (block)
+            m_charWriter->writeBuf(m_nbQueue+m_nbHead, contig);
+        else
+            n = nonBlockWriteDirect(m_nbQueue+m_nbHead, contig);
+
+        m_nbHead      = (m_nbHead + n) % m_nbSize;
+        m_nbCount    -= n;
+        m_nbOutTotal += n;
+
+        if (n!=contig)
+            break;
+    }
+
+    if (!m_nbCount)
+    {
+        m_nbHead = 0;
+        if (m_nbFlushPending)
+        {
+            m_nbFlushPending = false;
+            m_charWriter->flush();
+        }
+    }
+
+    return m_nbCount;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::nonBlockQueueColor( umba::term::colors::SgrColor clr )
+{
+    // После предыдущей отложенной смены в очередь ничего не добавлено - она просто заменяется
+    if (m_nbNumColors && (m_nbColors[m_nbNumColors-1].pos==m_nbInTotal || m_nbNumColors==nonBlockMaxPendingColors))
+    {
+        m_nbColors[m_nbNumColors-1].clr = clr;
+        return;
+    }
+
+    m_nbColors[m_nbNumColors].pos = m_nbInTotal;
+    m_nbColors[m_nbNumColors].clr = clr;
+    ++m_nbNumColors;
+}
+
+//-----------------------------------------------------------------------------
+// Передает устройству столько, сколько оно принимает без блокировки, порциями не больше getNonBlockMax()
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+size_t SimpleFormatter::nonBlockWriteDirect( const uint8_t *pBuf, size_t sz )
+{
+    size_t done = 0;
+    while(done!=sz)
+    {
+        size_t lim = m_charWriter->getNonBlockMax();
+        if (!lim)
+            break;
+
+        size_t n = sz-done;
+        if (n>lim)
+            n = lim;
+
+        m_charWriter->writeBuf(pBuf+done, n);
+        done += n;
+    }
+    return done;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::nonBlockEnqueue( const uint8_t *pBuf, size_t sz )
+{
+    size_t tail = (m_nbHead + m_nbCount) % m_nbSize;
+
+    size_t first = m_nbSize - tail;
+    if (first>sz)
+        first = sz;
+
+    std::memcpy(m_nbQueue+tail, pBuf, first);
+    std::memcpy(m_nbQueue, pBuf+first, sz-first);
+
+    m_nbCount   += sz;
+    m_nbInTotal += sz;
+    if (m_nbCount>m_nbStats.maxQueued)
+        m_nbStats.maxQueued = m_nbCount;
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::nonBlockWrite( const uint8_t *pBuf, size_t sz )
+{
+    // Порядок вывода сохраняется - напрямую пишем, только если очередь пуста
+    if (m_nbCount)
+        pumpNonBlock();
+
+    // drop - проверяем, поместится ли вывод целиком, до того как что-либо передать устройству
+    if (m_nbPolicy==NonBlockOverflowPolicy::drop)
+    {
+        size_t direct = m_nbCount ? 0 : m_charWriter->getNonBlockMax();
+        if (sz>direct && sz-direct > m_nbSize-m_nbCount)
+        {
+            ++m_nbStats.droppedWrites;
+            m_nbStats.droppedBytes += sz;
+            return;
+        }
+    }
+
+    if (!m_nbCount)
+    {
+        size_t n = nonBlockWriteDirect(pBuf, sz);
+        pBuf += n;
+        sz   -= n;
+    }
+
+    if (!sz)
+        return;
+
+    size_t room = m_nbSize - m_nbCount;
+    if (sz>room)
+    {
+        switch(m_nbPolicy)
+        {
+            case NonBlockOverflowPolicy::drop:
+                 // Устройство приняло меньше, чем сообщило при проверке, - начало уже выведено, это усечение
+                 ++m_nbStats.truncatedWrites;
+                 m_nbStats.droppedBytes += sz;
+                 return;
+
+            case NonBlockOverflowPolicy::truncate:
+                 ++m_nbStats.truncatedWrites;
+                 m_nbStats.droppedBytes += sz - room;
+                 sz = room;
+                 break;
+
+            case NonBlockOverflowPolicy::block:
+                 ++m_nbStats.blockedWrites;
+                 while(sz > m_nbSize - m_nbCount)
+                 {
+                     size_t part = m_nbSize - m_nbCount;
+                     nonBlockEnqueue(pBuf, part);
+                     pBuf += part;
+                     sz   -= part;
+                     pumpNonBlock();
+                 }
+                 break;
+        }
+    }
+
+    if (sz)
+        nonBlockEnqueue(pBuf, sz);
+}
+
+//-----------------------------------------------------------------------------
+UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
+void SimpleFormatter::nonBlockPutEndl()
+{
+    #if defined(UMBA_MCU_USED) || defined(_WIN32)
+    if (!m_charWriter->isTextMode())
+    {
+        nonBlockWrite((const uint8_t*)"\r\n", 2);
+        return;
+    }
+    #endif
+
+    nonBlockWrite((const uint8_t*)"\n", 1);
+}
+
 //-----------------------------------------------------------------------------
 UMBA_SIMPLE_FORMATTER_INLINE_FUNCTION
 void SimpleFormatter::pushLock( bool disableOutput )